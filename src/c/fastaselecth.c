@@ -1,7 +1,7 @@
 /*
 Program:   fastaselecth.c
-Version:   1.0.11
-Date:      20-MAY-2019
+Version:   1.0.36
+Date:      18-OCT-2026
 Author:    David Mathog, Biology Division, Caltech
 email:     mathog@caltech.edu
 Copyright: 2019 David Mathog and California Institute of Technology (Caltech)
@@ -26,6 +26,98 @@ Description:
 
 Changes:
 
+  1.0.36 18-OCT-2026
+         Added -out-tar FILE, which writes the -fragc or -fragg files as
+         entries of one tar archive, compressed by zstd when FILE ends in
+         .zst, instead of one file per group.
+  1.0.35 18-OCT-2026
+         Added -fragg, like -fragc but the groups need not be contiguous in
+         -sel.  Records are written group by group, groups in order of their
+         first selector, so each file is opened and written once.
+  1.0.34 18-OCT-2026
+         -frag groups are read into a table, each name once, and selectors
+         and held records carry the group number.  A record changes file
+         when its number differs from the last one, and each group's file
+         name is made and tracked the first time it is opened.
+  1.0.33 18-OCT-2026
+         The plain scan hashes the names of the next headers in its block
+         in batches and prefetches their selector set slots and names, so
+         the cache misses of a large selector set overlap.
+  1.0.32 18-OCT-2026
+         Header names are looked up in a hash table of the selectors.  The
+         hash is computed while the end of the name is found, so the name is
+         read once, not copied, scanned for -hi and compared at every step
+         of a binary search.
+  1.0.31 18-OCT-2026
+         Plain selections and rejections from a fasta -in, without
+         -out-format, -stats-seq, -validate, -replace-with or header
+         rewriting, use a scan that reads -in in blocks and handles each
+         record whole instead of line by line.  -wl was not used for the
+         line buffer, it is now.  Held records are built without copying
+         them again for every line.
+  1.0.30 18-OCT-2026
+         SIGINT and SIGTERM stop the scan at the next record.  The output
+         files of the run are removed, -fraga files are cut back to their
+         size before it, the counts so far are reported and the exit status
+         is 128 plus the signal number.
+  1.0.29 18-OCT-2026
+         Added -skip M and -head N, which emit only records M+1 to M+N in
+         output order and stop reading -in once the last is out.  With a
+         .2bit -in or -shm-index the skipped records are not read at all.
+  1.0.28 18-OCT-2026
+         With -reject the -sel file may be empty, every record is emitted.
+         The GUI uses this with -out-format tsv to list the records of -in.
+  1.0.27 18-OCT-2026
+         Added -shm-index DIR.  The header index of -in is published as a
+         file in DIR, normally the shared memory /dev/shm, and later runs map
+         it and seek straight to the selected records.
+  1.0.26 18-OCT-2026
+         Added -fingerprint, a sampled or a full, multithreaded, hash of -in
+         for telling whether it has changed.  Now needs -pthread.
+  1.0.25 18-OCT-2026
+         Added -manifest, which lists every emitted record with its output
+         file, byte offset, length and hash, and -verify, which rechecks the
+         output files against such a list.
+  1.0.24 18-OCT-2026
+         gzip compressed -in (and -diff files) are recognized and read through
+         rapidgzip, pigz or gzip, whichever is installed first in that order.
+  1.0.23 18-OCT-2026
+         Added -build-cache, which writes a DNA fasta -in as a .2bit file
+         for faster repeated selections.
+  1.0.22 18-OCT-2026
+         -in may be a UCSC .2bit file.  Records are found through its index
+         and decoded as they are written, nothing is buffered.
+  1.0.21 18-OCT-2026
+         Added -diff, which compares two fasta files by name and reports the
+         names found in only one of them and those whose sequences differ.
+  1.0.20 18-OCT-2026
+         Added -replace-with, which copies -in to -out with the records
+         named in an updates file taken from that file instead.
+  1.0.19 18-OCT-2026
+         Added -rename, -prefix and -strip-desc, which rewrite the header
+         lines of emitted records.
+  1.0.18 18-OCT-2026
+         Added -stats-seq and -stats-all: record count, N50, length
+         histogram, residue composition and GC content of the emitted
+         records, and optionally of all of -in, collected during the scan.
+  1.0.17 18-OCT-2026
+         Added -audit-dups, which checks that every header name in -in is
+         unique.  It needs no -sel and reads only the header lines.
+  1.0.16 18-OCT-2026
+         Added -validate and -alpha.  Every line of -in is checked while
+         selecting: residue alphabet, empty records, \r line ends, headers
+         without a name, and names used by more than one record.
+  1.0.15 18-OCT-2026
+         Added -missing-out and -dup-out, which write missing and duplicated
+         selectors to a file in one go instead of one warning per selector.
+  1.0.14 18-OCT-2026
+         Added -count and -check, which read only header lines and report
+         selector matches without writing any records.
+         -cod now keeps the first of the duplicated selectors and emits
+         every selected record, previously some could be lost.
+  1.0.13 18-OCT-2026
+         Added -out-format to emit tsv, ids, fai or bed lines instead of
+         fasta records.  Sequence lines are counted, not buffered.
   1.0.12 20-MAY-2019
          Added -cod, duplicates not fatal in select list, still fatal in
          fasta file.
@@ -81,44 +173,270 @@ License:  GNU General Public License 2
 Miscellaneous:
     This should be portable.  Compile like:
     
-    gcc -O3 -Wall -std=c99 -pedantic -o fastaselecth fastaselecth.c
+    gcc -O3 -Wall -std=c99 -pedantic -pthread -o fastaselecth fastaselecth.c
     
 
 */
 
+#define _POSIX_C_SOURCE 200809L  /* fseeko */
+#define _FILE_OFFSET_BITS 64
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <signal.h>
+#include <time.h>
 
 /* definitions and enums */
-#define EXVERSTRING "1.0.11  20-MAY-2019"
+#define EXVERSTRING "1.0.36  18-OCT-2026"
 #define COPYSTRING  "2019 David Mathog and California Institute of Technology"
 #define BUGSTRING   "mathog@caltech.edu"
 #define LICSTRING   "GNU General Public License 2"
 
 #define MYMAXSTRING 10000000
 #define DEFENTRIES     32000
+#define HDRBLOCK     4194304   /* bytes per read in the header scanner */
+#define SCAN_BLOCK   1048576   /* bytes per read in the plain scan, plus -wl */
+#define SCAN_BATCH        32   /* headers hashed and prefetched ahead by the plain scan */
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
+#define TWOBIT_MAGIC 0x1A412743
+#define TWOBIT_LINE       60   /* bases per line written from a .2bit record */
+#define TWOBIT_CHUNK  (TWOBIT_LINE * 4096)  /* bases decoded at a time, a multiple of 4 and TWOBIT_LINE */
+
+/* bitsets, one bit per selector */
+#define BITSET_BYTES(n)  (((n) + 7) / 8)
+#define BIT_SET(b,i)     ((b)[(i) >> 3] |= (unsigned char) (1 << ((i) & 7)))
+#define BIT_TEST(b,i)    ((b)[(i) >> 3] &  (1 << ((i) & 7)))
+
+#define ALPHA_PROTEIN 0
+#define ALPHA_DNA     1
+
+#define KEYSET_INIT   65536    /* initial slots in a keyset, a power of 2 */
+#define KEY_SEED 0x27D4EB2F165667C5ULL  /* key_hash() */
+#define KEY_MUL  0x9E3779B97F4A7C15ULL
+#define FPRINT_SAMPLED   1
+#define FPRINT_FULL      2
+#define FPRINT_BLOCK 65536     /* bytes per sample in a sampled fingerprint */
+#define FPRINT_NSAMPLE   16    /* samples, evenly spaced, the first and last included */
+#define FPRINT_CHUNK 67108864  /* bytes per leaf of a full fingerprint */
+#define FPRINT_THREADS   16    /* at most this many threads hash leaves */
+#define SHMIDX_MAGIC 0x3158444948534146ULL  /* "FSHSIDX1" */
+#define VALIDATE_SHOW 10       /* -validate reports this many of each problem */
+
+/* streaming XXH64 state, see xxh64_update() */
+typedef struct {
+   uint64_t      total;      /* bytes hashed so far */
+   uint64_t      v[4];
+   unsigned char mem[32];    /* partial stripe */
+   size_t        memsize;
+} XXH64STATE;
+
+/* an open .2bit file, see twobit_open() */
+typedef struct {
+   FILE   *fin;
+   int     swap;                  /* byte order of the file is not ours */
+   int     version;               /* 1 has 64 bit record offsets */
+   int     n;                     /* records */
+   char  **fnames;                /* record names in file order */
+   unsigned long long *offsets;   /* in file order */
+   char  **names;                 /* the same names, sorted for bin_search */
+   int    *order;                 /* file order index of names[i] */
+   unsigned char *pbuf;           /* packed bases */
+   char   *sbuf;                  /* decoded bases */
+   char   *obuf;                  /* decoded bases with line ends */
+} TWOBIT;
+
+/* one thread of a full fingerprint, see fingerprint() */
+typedef struct {
+   int       fd;
+   unsigned long long size;
+   unsigned long long nchunks;
+   unsigned long long first;      /* this thread hashes chunks first, first+step, ... */
+   unsigned long long step;
+   uint64_t *hashes;              /* one per chunk, shared */
+   int       failed;
+} FPRINT_JOB;
+
+/* -shm-index file: a SHMIDX_HEAD, n SHMIDX_ENTRY sorted by name, then the names */
+typedef struct {
+   uint64_t magic;
+   uint64_t key;                  /* fingerprint of -in and -hi, see shmidx_open() */
+   uint64_t n;
+   uint64_t poolsize;
+} SHMIDX_HEAD;
+typedef struct {
+   uint64_t name;                 /* offset in the name pool */
+   uint64_t hoffset;              /* offset in -in of the header line */
+   uint64_t end;                  /* and of the end of the record */
+   uint64_t dup;                  /* the name is used by more than one record */
+} SHMIDX_ENTRY;
+typedef struct {
+   char    *blob;                 /* the whole file, mapped or in memory */
+   size_t   bloblen;
+   int      mapped;
+   long long n;
+   SHMIDX_ENTRY *ent;
+   char    *pool;
+} SHMIDX;
+
+/* a slot of the selector set, see selset_find() */
+typedef struct {
+   unsigned long long hash;       /* 0 marks an empty slot */
+   const char        *name;
+   int                idx;        /* of name in the sorted selector list */
+} SELSLOT;
+
+/* headers ahead of the plain scan in its block, see scan_batch() */
+typedef struct {
+   int    n;                      /* headers in the batch */
+   int    i;                      /* the next one the scan comes to */
+   size_t to;                     /* every header start before this offset is in the batch */
+   size_t pos[SCAN_BATCH];        /* offset of the '>' */
+   size_t klen[SCAN_BATCH];       /* name length, SIZE_MAX to look it up from the header line */
+   unsigned long long hash[SCAN_BATCH];
+} SCANBATCH;
+
+/* state of the plain scan, see scan_plain() */
+typedef struct {
+   FILE  *fin;
+   FILE  *fout;
+   char **header_name_list;
+   int   *group_list;
+   int    entrynum;
+   int   *emitorder;
+   char **emitstrings;
+   int   *emitgroups;
+   unsigned char *emitlist;
+   int    lastemitted;
+   int    last_group;
+   char  *bigstring;              /* the header line */
+   char  *acc;                    /* the selected record being collected */
+   size_t acclen;
+   size_t accmax;
+   unsigned long long records;
+   unsigned long long emitted;
+} SCANSTATE;
+
+/* -stats-seq accumulator for one set of records */
+typedef struct {
+   unsigned long long  records;
+   unsigned long long  residues;
+   unsigned long long  current;      /* residues in the open record */
+   int                 open;         /* a record is being counted */
+   unsigned long long *lengths;      /* one per closed record, for N50 */
+   size_t              nlengths;
+   size_t              maxlengths;
+   unsigned long long  hist[4][256]; /* byte counts, 4 interleaved tables summed at the end */
+} SEQSTATS;
 
 #define FRAG_NONE   0
 #define FRAG_NEW    1
 #define FRAG_APPEND 2
+#define FRAG_GROUP  3
+
+#define OUTFMT_FASTA 0
+#define OUTFMT_TSV   1
+#define OUTFMT_IDS   2
+#define OUTFMT_FAI   3
+#define OUTFMT_BED   4
 
 /*function prototypes */
+void audit_dups(FILE *fin);
+void build_cache(FILE *fin, char *fname);
+void close_in(FILE *fin);
 int  bin_search(char *find, char **list, int size );
 int  convert_escape(char *string);
+FILE *drain(FILE *fout, char **emitstrings, int *emitgroups, int *lastemitted, int entrynum,
+   int *last_group, int all);
+void diff_files(char *fname_a, char *fname_b, char *bigstring);
+int  diff_next(FILE *fin, char *bigstring, int *pending, char **name, uint64_t *hash);
+void count_selectors(FILE *fin, char **header_name_list, int *emitorder, int entrynum);
+int  write_selectors(char *fname, char **header_name_list, int *emitorder, unsigned char *bits, int want, int entrynum);
 void emit_help(void);
 void emit_hhead(void);
-int  get_entries(char *bigstring, char ***header_name_list, char ***group_name_list);
+uint64_t fingerprint(char *fname, int mode);
+void *fingerprint_worker(void *arg);
+char *format_meta(char *header, unsigned long long hoffset, unsigned long long soffset,
+   unsigned long long length, int linebases, int linewidth);
+FILE *frag_open(FILE *fout, int group);
+void tar_close(void);
+void tar_end_entry(void);
+FILE *tar_entry(char *name);
+void tar_header(const char *name, char type, unsigned long long size);
+void tar_open(char *fname);
+int  get_updates(char *fname, char ***header_name_list, char ***update_text, size_t **update_len, char **update_buf);
+int  get_entries(char *fname, int pairs, char *bigstring, char ***header_name_list, char ***group_name_list, int **group_list);
+void group_free(void);
+int  group_intern(const char *name, size_t len);
+void group_order(int *group_list, int *emitorder, int entrynum);
+unsigned long long hash_key(const char *key, size_t klen);
+unsigned long long key_hash(const char *key, size_t klen);
+size_t key_scan(const char *name, unsigned long long *hash);
+int  keyset_add(const char *key, size_t klen, unsigned long long offset, unsigned long long *first);
+void keyset_free(void);
 void insane(char *string);
+FILE *open_in(char *fname);
+char *next_header(FILE *fin, unsigned long long *offset);
 int  lcl_strcasecmp(const char *s1, const char *s2);
+void man_add(const char *data, size_t len);
+void man_begin(const char *record);
+void man_end(void);
+void man_file(FILE *fout, char *fname);
+void man_record(const char *record, size_t len);
+int page_full(void);
+int page_take(void);
+void on_stop(int sig);
+void catch_stop(void);
+void out_track(const char *name, int append);
+void stop_run(FILE *fout, int entrynum, unsigned long long records, unsigned long long emitted);
+void write_failed(FILE *fout, char *string);
 char *lcl_strdup(const char *string);
-void remove_dups(char **header_name_list, char **group_name_list, int *emit_order, int *entrynum);
+void rewrite_header(char *buffer, char *header, size_t klen, char *newname);
+void remove_dups(char **header_name_list, int *group_list, int *emit_order, unsigned char *dupbits, int *entrynum);
 void setirangenumeric(int *val,int *numarg, int lower, int upper, int argc,char **argv,char * label);
+void selset_build(char **list, int n);
+int  selset_find(const char *key, size_t klen, unsigned long long h);
+void selset_free(void);
+int  selset_match(const char *name);
+int  scan_reject(SCANSTATE *sc);
+int  scan_select(SCANSTATE *sc);
+void shmidx_emit(SHMIDX *ix, long long i, FILE *fin, FILE *fout, char *buf);
+long long shmidx_find(SHMIDX *ix, char *name);
+void shmidx_free(SHMIDX *ix);
+SHMIDX *shmidx_open(char *dir, FILE *fin);
+void stats_close(SEQSTATS *st);
+int  stats_cmp_desc(const void *a, const void *b);
+void stats_header(SEQSTATS *st);
+void stats_line(SEQSTATS *st, const char *line, size_t linelen);
+void stats_report(FILE *fst, const char *label, SEQSTATS *st);
 void sort_entries(char **header_name_list, char **group_name_list, int *order, int entrynum);
+void validate_init(void);
+void verify_manifest(char *fname, char *bigstring);
+void validate_line(char *line, size_t linelen, int had_cr, unsigned long long offset);
+unsigned long long validate_report(void);
 void process_command_line_args(int argc,char **argv);
+void twobit_emit(TWOBIT *tb, int rec, char *header, FILE *fout, SEQSTATS *st);
+int  twobit_find(TWOBIT *tb, char *name);
+void twobit_free(TWOBIT *tb);
+TWOBIT *twobit_open(FILE *fin);
+unsigned int twobit_u32(TWOBIT *tb);
+void xxh64_reset(XXH64STATE *st);
+void xxh64_update(XXH64STATE *st, const void *data, size_t len);
+uint64_t xxh64_digest(XXH64STATE *st);
 
 /* global variables */
 char *gbl_hs;
@@ -131,6 +449,105 @@ int   gbl_com;
 int   gbl_cod;
 int   gbl_wl;
 int   gbl_reject;
+int   gbl_outfmt;
+int   gbl_count;
+int   gbl_check;
+char *gbl_missout;
+char *gbl_dupout;
+int   gbl_validate;
+int   gbl_alpha;
+int   gbl_audit;
+char *gbl_statsout;
+int   gbl_statsall;
+char *gbl_rename;
+char *gbl_prefix;
+int   gbl_stripdesc;
+char *gbl_replace;
+char *gbl_diffa;
+char *gbl_diffb;
+char *gbl_cache;
+char *gbl_manifest;
+char *gbl_outtar;
+char *gbl_verify;
+int   gbl_fprint;
+char *gbl_shmdir;
+int   gbl_skip;
+int   gbl_head;
+
+/* header scanner state, see next_header() */
+static char  *hs_buf=NULL;
+static size_t hs_pos=0;
+static size_t hs_end=0;
+static size_t hs_cap=0;
+static int    hs_bol=1;       /* hs_buf[0] starts a line */
+static int    hs_restore=0;   /* hs_buf[hs_pos-1] was a \n overwritten by the last call */
+static unsigned long long hs_base=0;  /* offset in the file of hs_buf[0] */
+
+/* .2bit decoding, 4 bases for each value of a packed byte, see twobit_open() */
+static char tb_bases[256][4];
+
+/* keyset state, see keyset_add() */
+static unsigned long long *ks_hash=NULL;  /* 0 marks an empty slot */
+static unsigned long long *ks_off=NULL;
+static size_t ks_size=0;
+static size_t ks_used=0;
+static FILE  *ks_fin=NULL;                /* second handle on -in for rereading headers */
+static char  *ks_line=NULL;
+static char **ks_key=NULL;                /* copies of the names instead, when -in cannot be reread */
+
+/* selector set state, see selset_find() */
+static SELSLOT *ss_slot=NULL;
+static size_t   ss_mask=0;
+static unsigned char hi_stop[256];        /* the -hi delimiters and '\0', see key_scan() */
+static unsigned char line_stop[256];      /* those and the line end, for names still in a block */
+
+/* -frag groups, see group_intern() */
+static char  **gp_name=NULL;
+static char  **gp_path=NULL;              /* output file, set when first opened */
+static int     gp_num=0;
+static int     gp_max=0;
+static int    *gp_slot=NULL;              /* hash table of group number + 1, 0 if empty */
+static size_t  gp_mask=0;
+
+/* -manifest state, see man_begin() */
+static FILE  *mf_out=NULL;
+static char  *mf_file="-";              /* current output file */
+static unsigned long long mf_pos=0;     /* its size so far */
+static char  *mf_key=NULL;              /* name of the open record, NULL if none */
+static size_t mf_keymax=0;
+static unsigned long long mf_start=0;
+static XXH64STATE mf_hash;
+
+/* output files of this run and their sizes before it, -1 if made by it, see out_track() */
+static char  **out_name=NULL;
+static off_t  *out_size=NULL;
+static int     out_num=0;
+static int     out_max=0;
+static volatile sig_atomic_t stop_signal=0;
+
+/* decompressor feeding the open -in, see open_in() */
+static pid_t  in_pid=0;
+
+/* -out-tar state, see tar_open() */
+static FILE  *tar_out=NULL;               /* the archive, or the pipe to zstd */
+static pid_t  tar_pid=0;                  /* zstd */
+static FILE  *tar_spool=NULL;             /* the open entry, copied to the archive when it ends */
+static char  *tar_name=NULL;              /* its name, NULL if none is open */
+static char  *tar_file=NULL;              /* -out-tar, NULL once it is complete */
+static time_t tar_mtime=0;
+
+/* -validate state, see validate_line() */
+static unsigned char vl_bad[256];         /* nonzero for characters outside -alpha */
+static unsigned long long vl_lineno=0;
+static unsigned long long vl_records=0;
+static unsigned long long vl_reclen=0;    /* residues in the current record */
+static unsigned long long vl_recline=0;   /* line number of the current header */
+static unsigned long long vl_badres=0;    /* counts of each problem */
+static unsigned long long vl_empty=0;
+static unsigned long long vl_cr=0;
+static unsigned long long vl_nokey=0;
+static unsigned long long vl_dupkey=0;
+static unsigned long long vl_orphan=0;
 
 
 /* functions */
@@ -160,24 +577,31 @@ void setirangenumeric(int *val,int *numarg, int lower, int upper, int argc,char
   }
 }
 
-/*  Read all of the entries to match from gbl_sel.
+/*  Read all of the entries to match from fname, -sel or -rename.
 
+   fname              file name, "-" is stdin
+   pairs              each line also has a second field, the -frag group or the new name
    bigstring          a buffer
    header_name_list   pointer to an array of character pointers
+   group_name_list    pointer to an array of character pointers for the second fields, NULL
+                      if not pairs, the pointer itself may be NULL then
+   group_list         if not NULL, the second fields are -frag groups and this receives an
+                      array of their group_intern() numbers instead, -1 where there is none
    
    Returns the number of names to search for.
 
 */
-int get_entries(char *bigstring, char ***header_name_list, char ***group_name_list){
+int get_entries(char *fname, int pairs, char *bigstring, char ***header_name_list, char ***group_name_list, int **group_list){
    int end,size;
    char **newlist;
+   int  *newgroups;
    char *newline;
    char *newstring;
    FILE *fin;
    int spanned;
 
-   if(strcmp(gbl_sel,"-")){
-      fin = fopen(gbl_sel,"r");
+   if(strcmp(fname,"-")){
+      fin = fopen(fname,"r");
       if(fin==NULL)insane("fastaselecth: fatal error: could not read input file");
    }
    else {
@@ -193,12 +617,17 @@ int get_entries(char *bigstring, char ***header_name_list, char ***group_name_li
    *header_name_list=newlist;
 
    // initial allocation
-   if(gbl_frag){
+   if(group_list){
+      newgroups=malloc(size*sizeof(int));
+      if(newgroups==NULL)insane("fastaselecth: fatal error: could not allocate memory");
+      *group_list=newgroups;
+   }
+   else if(pairs){
       newlist=malloc(size*sizeof(char *));
       if(newlist==NULL)insane("fastaselecth: fatal error: could not allocate memory");
       *group_name_list=newlist;
    }
-   else {
+   else if(group_name_list){
       *group_name_list=NULL;
    }
 
@@ -226,13 +655,22 @@ int get_entries(char *bigstring, char ***header_name_list, char ***group_name_li
        if(newstring==NULL)insane("fastaselecth: fatal error: could not allocate memory");
        (*header_name_list)[end]=newstring;
        strcpy(newstring,bigstring);
-       if(gbl_frag){
+       if(pairs || group_list){
           char *rest = bigstring+spanned+1;
+          if(group_list){
+            (*group_list)[end]=-1;
+          }
+          else {
+            (*group_name_list)[end]=NULL;
+          }
           spanned = strspn(rest,gbl_hs);   // consume all delimiters
           rest=rest+spanned;
           spanned = strcspn(rest,gbl_hs);  // find delimiter far side of "rest"
           
-          if(spanned>0){  /* ignore empty strings */
+          if(spanned>0 && group_list){  /* groups repeat, each name is kept once */
+            (*group_list)[end]=group_intern(rest,spanned);
+          }
+          else if(spanned>0){  /* ignore empty strings */
             rest[spanned] = '\0';
             newstring=malloc((spanned+1)*sizeof(char));
             if(newstring==NULL)insane("fastaselecth: fatal error: could not allocate memory");
@@ -248,7 +686,12 @@ int get_entries(char *bigstring, char ***header_name_list, char ***group_name_li
          if(newlist==NULL)insane("fastaselecth: fatal error: could not reallocate memory");
          *header_name_list=newlist;
 
-         if(gbl_frag){
+         if(group_list){
+           newgroups=realloc(*group_list,size*sizeof(int));
+           if(newgroups==NULL)insane("fastaselecth: fatal error: could not reallocate memory");
+           *group_list=newgroups;
+         }
+         else if(pairs){
            newlist=realloc(*group_name_list,size*sizeof(char *));
            if(newlist==NULL)insane("fastaselecth: fatal error: could not reallocate memory");
            *group_name_list=newlist;
@@ -256,88 +699,2762 @@ int get_entries(char *bigstring, char ***header_name_list, char ***group_name_li
        }
      }
    }
-   if(fin!=stdin){
-      fclose(fin);
+   if(fin!=stdin){
+      fclose(fin);
+   }
+   return end;
+}
+
+
+/* Read the -replace-with file into memory in one piece and index its records.
+
+   fname              the updates fasta file
+   header_name_list   receives the record names, parsed with -hi, which serve as selectors
+   update_text        receives a pointer to the start of each record, its > line
+   update_len         receives the length of each record, always ending in \n
+   update_buf         receives the buffer holding the file, to be freed by the caller
+   
+   Returns the number of records.
+*/
+int get_updates(char *fname, char ***header_name_list, char ***update_text, size_t **update_len, char **update_buf){
+   FILE  *fup;
+   char  *buf;
+   char  *p;
+   char  *eol;
+   char  *end;
+   size_t have=0;
+   size_t bufsize=HDRBLOCK;
+   size_t got;
+   size_t klen;
+   int    num=0;
+   int    size=DEFENTRIES;
+
+   fup = fopen(fname,"r");
+   if(!fup)insane("fastaselecth: fatal error: could not open -replace-with");
+   buf = malloc(bufsize + 2);
+   if(!buf)insane("fastaselecth: fatal error: could not allocate memory");
+   while((got = fread(buf + have, 1, bufsize - have, fup))){
+      have += got;
+      if(have == bufsize){
+         bufsize *= 2;
+         buf = realloc(buf, bufsize + 2);
+         if(!buf)insane("fastaselecth: fatal error: could not reallocate memory");
+      }
+   }
+   if(ferror(fup))insane("fastaselecth: fatal error: could not read -replace-with");
+   fclose(fup);
+   if(have && buf[have-1] != '\n')buf[have++] = '\n';
+   buf[have] = '\0';
+   end = buf + have;
+
+   *header_name_list = malloc(size*sizeof(char *));
+   *update_text      = malloc(size*sizeof(char *));
+   *update_len       = malloc(size*sizeof(size_t));
+   if(!*header_name_list || !*update_text || !*update_len)insane("fastaselecth: fatal error: could not allocate memory");
+   for(p = buf; p < end; p = eol + 1){
+      eol = memchr(p, '\n', end - p);
+      if(*p != '>'){
+         if(!num)insane("fastaselecth: fatal error: -replace-with does not start with a header line");
+         continue;
+      }
+      if(num){
+         (*update_len)[num-1] = p - (*update_text)[num-1];
+      }
+      if(num >= size){
+         size += DEFENTRIES;
+         *header_name_list = realloc(*header_name_list, size*sizeof(char *));
+         *update_text      = realloc(*update_text, size*sizeof(char *));
+         *update_len       = realloc(*update_len, size*sizeof(size_t));
+         if(!*header_name_list || !*update_text || !*update_len)insane("fastaselecth: fatal error: could not reallocate memory");
+      }
+      *eol = '\0';  /* for strcspn, put back below */
+      klen = strcspn(p + 1, gbl_hi);
+      *eol = '\n';
+      if(klen && p[klen] == '\r')klen--;
+      if(!klen)insane("fastaselecth: fatal error: -replace-with has a header without a name");
+      (*header_name_list)[num] = malloc(klen + 1);
+      if(!(*header_name_list)[num])insane("fastaselecth: fatal error: could not allocate memory");
+      memcpy((*header_name_list)[num], p + 1, klen);
+      (*header_name_list)[num][klen] = '\0';
+      (*update_text)[num] = p;
+      num++;
+   }
+   if(num){
+      (*update_len)[num-1] = end - (*update_text)[num-1];
+   }
+   *update_buf = buf;
+   return(num);
+}
+
+/* modified combsort with restart capability - keeps sort from
+degenerating into bubble sort on toxic data */
+void sort_entries(char **header_name_list, char **group_name_list, int *order, int entrynum){
+int done,gap,swaps;
+int restart=0;
+int i,j;
+char *temp;
+float shrink;
+int itemp;
+
+  shrink=1.3;
+  for(done=0; !done; ){
+    gap = (entrynum/2) - 1;
+    if(gap<1)gap=1;
+    for( ;gap>=1;gap/=shrink){
+      if(gap<1)gap=1;
+      swaps=0;
+      for(i=0,j=gap;j<entrynum;i++,j++){
+        if(strcmp(header_name_list[j],header_name_list[i])<0){
+          swaps++;
+          temp=header_name_list[i];
+          header_name_list[i]=header_name_list[j];
+          header_name_list[j]=temp;
+          if(group_name_list){
+            temp=group_name_list[i];
+            group_name_list[i]=group_name_list[j];
+            group_name_list[j]=temp;
+          }
+          itemp=order[i];
+          order[i]=order[j];
+          order[j]=itemp;
+        }
+      }
+      if(gap==1){
+        if(swaps==0){
+          done=1;
+          break;
+        }
+        else {
+          restart++;
+          if(restart > 7)break;
+        }
+      }
+    }
+  }
+}
+
+/* Remove repeated selectors from the sorted list.  With -dup-out the survivor's bit is set
+   in dupbits and the duplicate is neither reported nor fatal here, the caller handles that.
+*/
+void remove_dups(char **header_name_list, int *group_list, int *emit_order, unsigned char *dupbits, int *entrynum){
+int i;
+   if(*entrynum<=1)return;
+   char *dst=header_name_list[0];
+   int   didx=0;
+   for(i=1;i<*entrynum;i++){
+       if(strcmp(dst,header_name_list[i]) == 0){
+          if(gbl_dupout){
+             BIT_SET(dupbits,didx);
+          }
+          else if(gbl_cod){
+             fprintf(stderr,"fastaselecth: warning: duplicate entry name \"%s\" in -sel list, alternate header terminators may be needed\n",dst);
+          }
+          else {
+             insane("fastaselecth: fatal error: duplicate entry names in list, alternate header terminators may be needed");
+          }
+          /* keep the one which came first in the list */
+          if(emit_order[i] < emit_order[didx]){
+             emit_order[didx] = emit_order[i];
+             if(gbl_frag){
+                group_list[didx] = group_list[i];
+             }
+          }
+          free(header_name_list[i]);
+       }
+       else {
+          didx++;
+          if(didx != i){
+             header_name_list[didx] = header_name_list[i];
+             if(gbl_frag){
+                group_list[didx]       = group_list[i];
+             }
+             emit_order[didx]       = emit_order[i];
+          }
+          dst = header_name_list[didx];
+       }
+   }
+   if(didx+1 < *entrynum){
+      /* renumber emit_order to 0..didx so that the emit loops do not stall on the holes */
+      int *rank=calloc(*entrynum,sizeof(int));
+      if(!rank)insane("fastaselecth: fatal error: could not allocate memory");
+      for(i=0;i<=didx;i++){ rank[emit_order[i]]=1; }
+      for(i=1;i<*entrynum;i++){ rank[i] += rank[i-1]; }
+      for(i=0;i<=didx;i++){ emit_order[i] = rank[emit_order[i]] - 1; }
+      free(rank);
+   }
+   *entrynum=didx+1;
+}
+
+/* Header scanner.  Returns the next header line in fin, without the > and the line end,
+   or NULL at the end of the file.  Sequence lines are skipped by memchr() over large
+   blocks and are never copied.  *offset receives the position of the header line in fin.
+   The returned string is valid until the next call.
+*/
+char *next_header(FILE *fin, unsigned long long *offset){
+   char  *gt;
+   char  *eol;
+   size_t keep;
+   size_t got;
+
+   if(!hs_buf){
+      hs_cap = HDRBLOCK + gbl_wl + 1;
+      hs_buf = malloc(hs_cap);
+      if(!hs_buf)insane("fastaselecth: fatal error: could not allocate memory");
+   }
+   if(hs_restore){
+      hs_buf[hs_pos-1] = '\n';
+      hs_restore = 0;
+   }
+   while(1){
+      while(hs_pos < hs_end){
+         gt = memchr(hs_buf + hs_pos, '>', hs_end - hs_pos);
+         if(!gt){
+            hs_bol = (hs_buf[hs_end - 1] == '\n');
+            hs_pos = hs_end;
+            break;
+         }
+         hs_pos = gt - hs_buf;
+         if(hs_pos ? hs_buf[hs_pos-1] == '\n' : hs_bol){
+            eol = memchr(gt, '\n', hs_end - hs_pos);
+            if(!eol && feof(fin))eol = hs_buf + hs_end;  /* last line lacks a \n */
+            if(!eol)break;                               /* finish reading this header */
+            *offset = hs_base + hs_pos;
+            if(eol < hs_buf + hs_end){
+               hs_pos = eol - hs_buf + 1;
+               hs_restore = 1;
+            }
+            else {
+               hs_pos = hs_end;
+            }
+            *eol = '\0';
+            if(eol > gt + 1 && eol[-1] == '\r')eol[-1] = '\0';
+            return(gt + 1);
+         }
+         hs_pos++;
+      }
+
+      /* refill, moving a partial header line to the front */
+      keep = hs_end - hs_pos;
+      if(keep){
+         if(keep > (size_t) gbl_wl){
+            (void) fprintf(stderr,"fastaselecth: fatal error: input record in fasta file exceeds %d characters\n",gbl_wl); 
+            exit(EXIT_FAILURE);
+         }
+         memmove(hs_buf, hs_buf + hs_pos, keep);
+         hs_bol = 1;
+      }
+      hs_base += hs_pos;
+      hs_pos = 0;
+      hs_end = keep;
+      got = fread(hs_buf + hs_end, 1, hs_cap - 1 - hs_end, fin);
+      if(ferror(fin))insane("fastaselecth: fatal error: could not read -in");
+      hs_end += got;
+      if(!hs_end)return(NULL);
+   }
+}
+
+/* 64 bit FNV-1a hash of the klen characters of key.  Never returns 0. */
+unsigned long long hash_key(const char *key, size_t klen){
+   unsigned long long h = 14695981039346656037ULL;
+   const unsigned char *k = (const unsigned char *) key;
+   while(klen--){
+      h ^= *k++;
+      h *= 1099511628211ULL;
+   }
+   return(h ? h : 1);
+}
+
+/* Keyset: the names of all fasta headers seen so far, in an open addressing table.  Only
+   a hash and the offset of the header line in -in are stored.  When a hash is already
+   present that header is reread from -in to tell a true duplicate from a collision.
+   A decompressed -in cannot be reread, then a copy of each name is kept as well.
+
+   Returns 1 and sets *first to the earlier header's offset if key was already present,
+   otherwise adds it and returns 0.
+*/
+int keyset_add(const char *key, size_t klen, unsigned long long offset, unsigned long long *first){
+   unsigned long long h = hash_key(key,klen);
+   size_t slot;
+   size_t i;
+
+   if(ks_used * 2 >= ks_size){  /* keep the load at or below 1/2 */
+      unsigned long long *old_hash = ks_hash;
+      unsigned long long *old_off  = ks_off;
+      char **old_key = ks_key;
+      size_t old_size = ks_size;
+      ks_size = (ks_size ? 2*ks_size : KEYSET_INIT);
+      ks_hash = calloc(ks_size,sizeof(unsigned long long));
+      ks_off  = malloc(ks_size*sizeof(unsigned long long));
+      if(!ks_hash || !ks_off)insane("fastaselecth: fatal error: could not allocate memory");
+      if(in_pid){
+         ks_key = malloc(ks_size*sizeof(char *));
+         if(!ks_key)insane("fastaselecth: fatal error: could not allocate memory");
+      }
+      for(i=0;i<old_size;i++){
+         if(!old_hash[i])continue;
+         for(slot = old_hash[i] & (ks_size-1); ks_hash[slot]; slot = (slot+1) & (ks_size-1)){}
+         ks_hash[slot] = old_hash[i];
+         ks_off[slot]  = old_off[i];
+         if(ks_key)ks_key[slot] = old_key[i];
+      }
+      free(old_hash);
+      free(old_off);
+      free(old_key);
+   }
+
+   for(slot = h & (ks_size-1); ks_hash[slot]; slot = (slot+1) & (ks_size-1)){
+      if(ks_hash[slot] != h)continue;
+      if(ks_key){
+         if(strlen(ks_key[slot]) == klen && !strncmp(ks_key[slot],key,klen)){
+            *first = ks_off[slot];
+            return(1);
+         }
+         continue;
+      }
+      if(!ks_fin){
+         ks_fin  = fopen(gbl_in,"r");
+         ks_line = malloc(gbl_wl + 1);
+         if(!ks_fin || !ks_line)insane("fastaselecth: fatal error: could not reopen -in");
+      }
+      if(fseeko(ks_fin, (off_t) ks_off[slot] + 1, SEEK_SET) || !fgets(ks_line, gbl_wl + 1, ks_fin)){
+         insane("fastaselecth: fatal error: could not reread a header in -in");
+      }
+      ks_line[strcspn(ks_line,"\r\n")] = '\0';
+      if(strcspn(ks_line,gbl_hi) == klen && !strncmp(ks_line,key,klen)){
+         *first = ks_off[slot];
+         return(1);
+      }
+   }
+   ks_hash[slot] = h;
+   ks_off[slot]  = offset;
+   if(ks_key){
+      ks_key[slot] = malloc(klen + 1);
+      if(!ks_key[slot])insane("fastaselecth: fatal error: could not allocate memory");
+      memcpy(ks_key[slot], key, klen);
+      ks_key[slot][klen] = '\0';
+   }
+   ks_used++;
+   return(0);
+}
+
+void keyset_free(void){
+   size_t i;
+   if(ks_key){
+      for(i=0;i<ks_size;i++){
+         if(ks_hash[i])free(ks_key[i]);
+      }
+      free(ks_key);
+      ks_key = NULL;
+   }
+   free(ks_hash);
+   free(ks_off);
+   free(ks_line);
+   if(ks_fin)fclose(ks_fin);
+   ks_hash = ks_off = NULL;
+   ks_line = NULL;
+   ks_fin  = NULL;
+   ks_size = ks_used = 0;
+}
+
+/* Selector set.  The sorted selector names in an open addressing table by key_hash(), so that
+   a header name is found with the hash key_scan() computed while finding the end of the name,
+   and usually a single compare, instead of a binary search that compares at every step.
+   selset_find() returns the index of the name in the sorted list, as bin_search() does, or -1.
+*/
+static unsigned long long key_mix(unsigned long long h, unsigned long long w){
+   h = (h ^ w) * KEY_MUL;
+   return(h ^ (h >> 32));
+}
+/* Hash of the klen characters of key, taken 8 at a time, so one multiply per 8 bytes.  Never 0. */
+unsigned long long key_hash(const char *key, size_t klen){
+   const unsigned char *k = (const unsigned char *) key;
+   unsigned long long h = KEY_SEED;
+   unsigned long long w = 0;
+   int    shift = 0;
+   size_t i;
+   for(i=0;i<klen;i++){
+      w |= (unsigned long long) k[i] << shift;
+      shift += 8;
+      if(shift == 64){
+         h = key_mix(h, w);
+         w = 0;
+         shift = 0;
+      }
+   }
+   h = key_mix(key_mix(h, w), klen);
+   return(h ? h : 1);
+}
+/* The length of the name at name, up to the first byte marked in stop, and in *hash its
+   key_hash(), computed in the same pass.
+*/
+static size_t key_walk(const char *name, const unsigned char *stop, unsigned long long *hash){
+   const unsigned char *k = (const unsigned char *) name;
+   unsigned long long h = KEY_SEED;
+   unsigned long long w = 0;
+   int    shift = 0;
+   size_t i;
+   for(i=0;!stop[k[i]];i++){
+      w |= (unsigned long long) k[i] << shift;
+      shift += 8;
+      if(shift == 64){
+         h = key_mix(h, w);
+         w = 0;
+         shift = 0;
+      }
+   }
+   h = key_mix(key_mix(h, w), i);
+   *hash = (h ? h : 1);
+   return(i);
+}
+/* The length of the name at name, up to the first -hi delimiter or the end of the string, and
+   in *hash its key_hash().
+*/
+size_t key_scan(const char *name, unsigned long long *hash){
+   return(key_walk(name, hi_stop, hash));
+}
+void selset_build(char **list, int n){
+   size_t slot;
+   int    i;
+   memset(hi_stop, 0, sizeof(hi_stop));
+   for(i=0;gbl_hi[i];i++){ hi_stop[(unsigned char) gbl_hi[i]] = 1; }
+   hi_stop[0] = 1;
+   memcpy(line_stop, hi_stop, sizeof(line_stop));
+   line_stop['\n'] = line_stop['\r'] = 1;
+   for(ss_mask=16; ss_mask < 2 * (size_t) n; ss_mask *= 2){}
+   ss_slot = calloc(ss_mask, sizeof(SELSLOT));
+   if(!ss_slot)insane("fastaselecth: fatal error: could not allocate memory");
+   ss_mask--;
+   for(i=0;i<n;i++){
+      unsigned long long h = key_hash(list[i], strlen(list[i]));
+      for(slot = h & ss_mask; ss_slot[slot].hash; slot = (slot + 1) & ss_mask){}
+      ss_slot[slot].hash = h;
+      ss_slot[slot].name = list[i];
+      ss_slot[slot].idx  = i;
+   }
+}
+int selset_find(const char *key, size_t klen, unsigned long long h){
+   size_t slot;
+   for(slot = h & ss_mask; ss_slot[slot].hash; slot = (slot + 1) & ss_mask){
+      if(ss_slot[slot].hash == h){
+         const char *s = ss_slot[slot].name;
+         if(!strncmp(s, key, klen) && s[klen] == '\0')return(ss_slot[slot].idx);
+      }
+   }
+   return(-1);
+}
+/* The selector for the header line at name, after its '>'.  A header starting with a
+   delimiter is matched whole, as it always has been.
+*/
+int selset_match(const char *name){
+   unsigned long long h;
+   size_t klen = key_scan(name, &h);
+   if(!klen && *name){
+      klen = strlen(name);
+      h = key_hash(name, klen);
+   }
+   return(selset_find(name, klen, h));
+}
+void selset_free(void){
+   free(ss_slot);
+   ss_slot = NULL;
+}
+
+/* The number of the -frag group named by the len characters at name, adding it to the table
+   if it is new.  Numbers are dense from 0, in order of first appearance in -sel.
+*/
+int group_intern(const char *name, size_t len){
+   unsigned long long h = key_hash(name, len);
+   size_t i;
+   int    g;
+   if(2*(size_t)(gp_num + 1) > gp_mask){  /* keep the table at most half full */
+      size_t nslots = (gp_mask ? 2*(gp_mask + 1) : 256);
+      free(gp_slot);
+      gp_slot = calloc(nslots, sizeof(int));
+      if(!gp_slot)insane("fastaselecth: fatal error: could not allocate memory");
+      gp_mask = nslots - 1;
+      for(g=0;g<gp_num;g++){
+         for(i = key_hash(gp_name[g], strlen(gp_name[g])) & gp_mask; gp_slot[i]; i = (i + 1) & gp_mask){}
+         gp_slot[i] = g + 1;
+      }
+   }
+   for(i = h & gp_mask; gp_slot[i]; i = (i + 1) & gp_mask){
+      g = gp_slot[i] - 1;
+      if(!strncmp(gp_name[g], name, len) && gp_name[g][len] == '\0')return(g);
+   }
+   if(gp_num == gp_max){
+      gp_max = (gp_max ? 2*gp_max : 64);
+      gp_name = realloc(gp_name, gp_max*sizeof(char *));
+      gp_path = realloc(gp_path, gp_max*sizeof(char *));
+      if(!gp_name || !gp_path)insane("fastaselecth: fatal error: could not allocate memory");
+   }
+   gp_name[gp_num] = malloc(len + 1);
+   if(!gp_name[gp_num])insane("fastaselecth: fatal error: could not allocate memory");
+   memcpy(gp_name[gp_num], name, len);
+   gp_name[gp_num][len] = '\0';
+   gp_path[gp_num] = NULL;
+   gp_slot[i] = gp_num + 1;
+   return(gp_num++);
+}
+void group_free(void){
+   int g;
+   for(g=0;g<gp_num;g++){
+      free(gp_name[g]);
+      free(gp_path[g]);
+   }
+   free(gp_name);
+   free(gp_path);
+   free(gp_slot);
+   gp_name = gp_path = NULL;
+   gp_slot = NULL;
+   gp_num = gp_max = 0;
+}
+
+/* -fragg.  Renumber the -sel positions in emitorder so that each group's selectors follow
+   one another, groups in order of their first selector and -sel order within a group.  The
+   records are then written a group at a time, held until their group comes up.  Selectors
+   without a group go last, they are fatal if they match anyway.
+*/
+void group_order(int *group_list, int *emitorder, int entrynum){
+   int *bypos = malloc((entrynum + 1)*sizeof(int));
+   int *start = calloc(gp_num + 2,sizeof(int));
+   int  i,g;
+   if(!bypos || !start)insane("fastaselecth: fatal error: could not allocate memory");
+   for(i=0;i<entrynum;i++){
+      bypos[emitorder[i]] = i;
+      g = (group_list[i] == -1 ? gp_num : group_list[i]);
+      start[g + 1]++;
+   }
+   for(g=1;g<=gp_num;g++){ start[g] += start[g-1]; }
+   for(i=0;i<entrynum;i++){
+      g = group_list[bypos[i]];
+      if(g == -1)g = gp_num;
+      emitorder[bypos[i]] = start[g]++;
+   }
+   free(start);
+   free(bypos);
+}
+
+/* Set up the -alpha lookup table for validate_line(). */
+void validate_init(void){
+   int c;
+   const char *dna = "ACGTURYSWKMBDHVN-";
+   memset(vl_bad, 1, sizeof(vl_bad));
+   if(gbl_alpha == ALPHA_DNA){
+      for(; *dna; dna++){
+         vl_bad[(unsigned char) *dna] = 0;
+         vl_bad[tolower((unsigned char) *dna)] = 0;
+      }
+   }
+   else {
+      for(c='A'; c<='Z'; c++){
+         vl_bad[c] = 0;
+         vl_bad[tolower(c)] = 0;
+      }
+      vl_bad['*'] = 0;
+      vl_bad['-'] = 0;
+   }
+}
+
+/* Validation of one line of -in, line end removed.  Problems are counted and the first
+   VALIDATE_SHOW of each kind are reported on stderr.  Call with NULL at the end of -in
+   to finish the last record.
+*/
+void validate_line(char *line, size_t linelen, int had_cr, unsigned long long offset){
+   const unsigned char *u;
+   unsigned char acc;
+   size_t i;
+
+   if(line && line[0] != '>'){
+      vl_lineno++;
+      if(!vl_records && linelen){
+         if(vl_orphan++ < VALIDATE_SHOW)(void) fprintf(stderr,"fastaselecth: validate: line %llu: sequence before the first header\n",vl_lineno);
+      }
+      /* branch free table lookup, a bad character anywhere leaves acc nonzero */
+      u = (const unsigned char *) line;
+      acc = 0;
+      for(i=0; i + 8 <= linelen; i += 8){
+         acc |= vl_bad[u[i]]   | vl_bad[u[i+1]] | vl_bad[u[i+2]] | vl_bad[u[i+3]] |
+                vl_bad[u[i+4]] | vl_bad[u[i+5]] | vl_bad[u[i+6]] | vl_bad[u[i+7]];
+      }
+      for(; i < linelen; i++){ acc |= vl_bad[u[i]]; }
+      if(acc){
+         if(vl_badres++ < VALIDATE_SHOW){
+            for(i=0; !vl_bad[u[i]]; i++){}
+            (void) fprintf(stderr,"fastaselecth: validate: line %llu: character 0x%02x at column %lu is not in the -alpha alphabet\n",
+               vl_lineno, (unsigned int) u[i], (unsigned long) i + 1);
+         }
+      }
+      vl_reclen += linelen;
+      if(had_cr && vl_cr++ < VALIDATE_SHOW)(void) fprintf(stderr,"fastaselecth: validate: line %llu: \\r line end\n",vl_lineno);
+      return;
+   }
+
+   /* a header or the end of -in finishes the preceding record */
+   if(vl_records && !vl_reclen){
+      if(vl_empty++ < VALIDATE_SHOW)(void) fprintf(stderr,"fastaselecth: validate: line %llu: record has no sequence\n",vl_recline);
+   }
+   if(!line)return;
+
+   vl_lineno++;
+   vl_records++;
+   vl_reclen  = 0;
+   vl_recline = vl_lineno;
+   if(had_cr && vl_cr++ < VALIDATE_SHOW)(void) fprintf(stderr,"fastaselecth: validate: line %llu: \\r line end\n",vl_lineno);
+   i = strcspn(line+1,gbl_hi);
+   if(!i){
+      if(vl_nokey++ < VALIDATE_SHOW)(void) fprintf(stderr,"fastaselecth: validate: line %llu: header has no name\n",vl_lineno);
+   }
+   else {
+      unsigned long long first;
+      if(keyset_add(line+1, i, offset, &first)){
+         if(vl_dupkey++ < VALIDATE_SHOW)(void) fprintf(stderr,"fastaselecth: validate: line %llu: name %.*s already used by the header at byte %llu\n",
+            vl_lineno, (int) i, line+1, first);
+      }
+   }
+}
+
+/* Summarize -validate.  Returns the number of problems found. */
+unsigned long long validate_report(void){
+   unsigned long long problems = vl_badres + vl_empty + vl_cr + vl_nokey + vl_dupkey + vl_orphan;
+   (void) fprintf(stderr,"fastaselecth: validate: records: %llu, lines with bad characters: %llu, empty records: %llu, \\r line ends: %llu,"
+      " headers without name: %llu, duplicate names: %llu, sequence lines before first header: %llu\n",
+      vl_records, vl_badres, vl_empty, vl_cr, vl_nokey, vl_dupkey, vl_orphan);
+   keyset_free();
+   return(problems);
+}
+
+/* Write to fname, in -sel order, every selector whose bit in bits is (want ? set : clear).
+   The whole list goes out through one large stdio buffer.  Returns the number written.
+*/
+int write_selectors(char *fname, char **header_name_list, int *emitorder, unsigned char *bits, int want, int entrynum){
+   FILE *fsel;
+   int  *listed;
+   int   i;
+   int   count=0;
+
+   if(strcmp(fname,"-")){
+      fsel = fopen(fname,"w");
+      if(!fsel){
+         (void) fprintf(stderr,"fastaselecth: fatal error: file name: %s\n",fname);
+         insane("fastaselecth: fatal error: could not open -missing-out or -dup-out");
+      }
+   }
+   else {
+      fsel = stdout;
+   }
+   (void) setvbuf(fsel, NULL, _IOFBF, HDRBLOCK);
+   listed=malloc(entrynum*sizeof(int));
+   if(!listed)insane("fastaselecth: fatal error: could not allocate memory");
+   for(i=0;i<entrynum;i++){ listed[emitorder[i]]=i; }
+   for(i=0;i<entrynum;i++){
+      if(!BIT_TEST(bits,listed[i]) == !want){
+         (void) fputs(header_name_list[listed[i]],fsel);
+         (void) fputc('\n',fsel);
+         count++;
+      }
+   }
+   free(listed);
+   if(fsel==stdout){
+      (void) fflush(fsel);
+   }
+   else if(fclose(fsel)){
+      insane("fastaselecth: fatal error: could not write -missing-out or -dup-out");
+   }
+   return(count);
+}
+
+/* -stats-seq.  A record is opened by stats_header(), sequence lines are added with
+   stats_line(), and it is closed by stats_close() or the next stats_header().
+*/
+void stats_close(SEQSTATS *st){
+   if(!st->open)return;
+   if(st->nlengths >= st->maxlengths){
+      st->maxlengths = (st->maxlengths ? 2*st->maxlengths : DEFENTRIES);
+      st->lengths = realloc(st->lengths, st->maxlengths*sizeof(unsigned long long));
+      if(!st->lengths)insane("fastaselecth: fatal error: could not reallocate memory");
+   }
+   st->lengths[st->nlengths++] = st->current;
+   st->open = 0;
+}
+
+void stats_header(SEQSTATS *st){
+   stats_close(st);
+   st->records++;
+   st->current = 0;
+   st->open = 1;
+}
+
+void stats_line(SEQSTATS *st, const char *line, size_t linelen){
+   const unsigned char *u = (const unsigned char *) line;
+   unsigned long long *h0 = st->hist[0];
+   unsigned long long *h1 = st->hist[1];
+   unsigned long long *h2 = st->hist[2];
+   unsigned long long *h3 = st->hist[3];
+   size_t i;
+   /* four tables so that runs of one character do not serialize on a single counter */
+   for(i=0; i + 4 <= linelen; i += 4){
+      h0[u[i]]++;
+      h1[u[i+1]]++;
+      h2[u[i+2]]++;
+      h3[u[i+3]]++;
+   }
+   for(; i < linelen; i++){ h0[u[i]]++; }
+   st->current  += linelen;
+   st->residues += linelen;
+}
+
+int  stats_cmp_desc(const void *a, const void *b){
+   unsigned long long la = *(const unsigned long long *) a;
+   unsigned long long lb = *(const unsigned long long *) b;
+   return( la < lb ? 1 : (la > lb ? -1 : 0));
+}
+
+/* Write the report for one set.  Lengths are sorted in place and released. */
+void stats_report(FILE *fst, const char *label, SEQSTATS *st){
+   unsigned long long counts[256];
+   unsigned long long bins[65];
+   unsigned long long sum;
+   unsigned long long gc;
+   unsigned long long at;
+   size_t i;
+   int    c;
+   int    b;
+   int    want;
+
+   stats_close(st);
+   qsort(st->lengths, st->nlengths, sizeof(unsigned long long), stats_cmp_desc);
+   (void) fprintf(fst,"[%s]\n",label);
+   (void) fprintf(fst,"records\t%llu\n",st->records);
+   (void) fprintf(fst,"residues\t%llu\n",st->residues);
+   if(st->nlengths){
+      (void) fprintf(fst,"min_length\t%llu\n",st->lengths[st->nlengths - 1]);
+      (void) fprintf(fst,"max_length\t%llu\n",st->lengths[0]);
+      (void) fprintf(fst,"mean_length\t%.1f\n",(double) st->residues / st->nlengths);
+      for(want=50, sum=0, i=0; i < st->nlengths && want <= 90; i++){
+         sum += st->lengths[i];
+         while(want <= 90 && sum * 100 >= st->residues * want){
+            (void) fprintf(fst,"N%d\t%llu\nL%d\t%lu\n",want,st->lengths[i],want,(unsigned long) i + 1);
+            want += 40;
+         }
+      }
+   }
+
+   for(c=0;c<256;c++){
+      counts[c] = st->hist[0][c] + st->hist[1][c] + st->hist[2][c] + st->hist[3][c];
+   }
+   gc = counts['G'] + counts['g'] + counts['C'] + counts['c'] + counts['S'] + counts['s'];
+   at = counts['A'] + counts['a'] + counts['T'] + counts['t'] + counts['U'] + counts['u'] + counts['W'] + counts['w'];
+   if(gc + at){
+      (void) fprintf(fst,"gc_fraction\t%.4f\n",(double) gc / (gc + at));
+   }
+
+   /* length histogram, bin b holds lengths 2^b to 2^(b+1)-1, bin 64 holds 0 */
+   memset(bins, 0, sizeof(bins));
+   for(i=0;i<st->nlengths;i++){
+      unsigned long long len = st->lengths[i];
+      if(!len){
+         bins[64]++;
+         continue;
+      }
+      for(b=0; len >>= 1; b++){}
+      bins[b]++;
+   }
+   if(bins[64])(void) fprintf(fst,"length\t0-0\t%llu\n",bins[64]);
+   for(b=0;b<64;b++){
+      if(bins[b])(void) fprintf(fst,"length\t%llu-%llu\t%llu\n",1ULL << b,(2ULL << b) - 1,bins[b]);
+   }
+
+   for(c=0;c<256;c++){
+      if(!counts[c])continue;
+      if(isgraph(c)){
+         (void) fprintf(fst,"residue\t%c\t%llu\n",c,counts[c]);
+      }
+      else {
+         (void) fprintf(fst,"residue\t0x%02x\t%llu\n",c,counts[c]);
+      }
+   }
+   free(st->lengths);
+   st->lengths = NULL;
+}
+
+/* XXH64 (Yann Collet's xxHash, 64 bit, seed 0), fed in pieces of any size.
+   Used where a record's sequence must be compared without keeping it.
+*/
+#define XXH_P1 0x9E3779B185EBCA87ULL
+#define XXH_P2 0xC2B2AE3D27D4EB4FULL
+#define XXH_P3 0x165667B19E3779F9ULL
+#define XXH_P4 0x85EBCA77C2B2AE63ULL
+#define XXH_P5 0x27D4EB2F165667C5ULL
+#define XXH_ROTL(x,r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t xxh_read64(const unsigned char *p){
+   return( (uint64_t) p[0]        | ((uint64_t) p[1] << 8)  | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+          ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56));
+}
+static uint64_t xxh_read32(const unsigned char *p){
+   return( (uint64_t) p[0] | ((uint64_t) p[1] << 8) | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24));
+}
+static uint64_t xxh_round(uint64_t acc, uint64_t input){
+   acc += input * XXH_P2;
+   acc  = XXH_ROTL(acc,31);
+   return(acc * XXH_P1);
+}
+static uint64_t xxh_merge(uint64_t acc, uint64_t val){
+   acc ^= xxh_round(0, val);
+   return(acc * XXH_P1 + XXH_P4);
+}
+void xxh64_reset(XXH64STATE *st){
+   st->total   = 0;
+   st->v[0]    = XXH_P1 + XXH_P2;
+   st->v[1]    = XXH_P2;
+   st->v[2]    = 0;
+   st->v[3]    = 0 - XXH_P1;
+   st->memsize = 0;
+}
+void xxh64_update(XXH64STATE *st, const void *data, size_t len){
+   const unsigned char *p = data;
+   const unsigned char *end = p + len;
+   size_t fill;
+
+   st->total += len;
+   if(st->memsize + len < 32){
+      memcpy(st->mem + st->memsize, p, len);
+      st->memsize += len;
+      return;
+   }
+   if(st->memsize){
+      fill = 32 - st->memsize;
+      memcpy(st->mem + st->memsize, p, fill);
+      st->v[0] = xxh_round(st->v[0], xxh_read64(st->mem));
+      st->v[1] = xxh_round(st->v[1], xxh_read64(st->mem + 8));
+      st->v[2] = xxh_round(st->v[2], xxh_read64(st->mem + 16));
+      st->v[3] = xxh_round(st->v[3], xxh_read64(st->mem + 24));
+      p += fill;
+      st->memsize = 0;
+   }
+   for( ; p + 32 <= end; p += 32){
+      st->v[0] = xxh_round(st->v[0], xxh_read64(p));
+      st->v[1] = xxh_round(st->v[1], xxh_read64(p + 8));
+      st->v[2] = xxh_round(st->v[2], xxh_read64(p + 16));
+      st->v[3] = xxh_round(st->v[3], xxh_read64(p + 24));
+   }
+   if(p < end){
+      memcpy(st->mem, p, end - p);
+      st->memsize = end - p;
+   }
+}
+uint64_t xxh64_digest(XXH64STATE *st){
+   const unsigned char *p = st->mem;
+   const unsigned char *end = p + st->memsize;
+   uint64_t h;
+
+   if(st->total >= 32){
+      h = XXH_ROTL(st->v[0],1) + XXH_ROTL(st->v[1],7) + XXH_ROTL(st->v[2],12) + XXH_ROTL(st->v[3],18);
+      h = xxh_merge(h, st->v[0]);
+      h = xxh_merge(h, st->v[1]);
+      h = xxh_merge(h, st->v[2]);
+      h = xxh_merge(h, st->v[3]);
+   }
+   else {
+      h = st->v[2] + XXH_P5;
+   }
+   h += st->total;
+   for( ; p + 8 <= end; p += 8){
+      h ^= xxh_round(0, xxh_read64(p));
+      h  = XXH_ROTL(h,27) * XXH_P1 + XXH_P4;
+   }
+   if(p + 4 <= end){
+      h ^= xxh_read32(p) * XXH_P1;
+      h  = XXH_ROTL(h,23) * XXH_P2 + XXH_P3;
+      p += 4;
+   }
+   for( ; p < end; p++){
+      h ^= *p * XXH_P5;
+      h  = XXH_ROTL(h,11) * XXH_P1;
+   }
+   h ^= h >> 33;
+   h *= XXH_P2;
+   h ^= h >> 29;
+   h *= XXH_P3;
+   h ^= h >> 32;
+   return(h);
+}
+
+/* Read the next record of fin for -diff.  The name, up to the first -hi character, is returned
+   in a malloc'd string, and the XXH64 of the sequence with the line ends removed, so that the
+   line width does not matter.  bigstring keeps the next header line between calls, *pending
+   says so.  Returns 0 at the end of the file.
+*/
+int diff_next(FILE *fin, char *bigstring, int *pending, char **name, uint64_t *hash){
+   XXH64STATE st;
+   size_t len;
+   
+   while(!*pending){
+      if(!fgets(bigstring, gbl_wl + 1, fin))return(0);
+      if(bigstring[0]=='>')*pending=1;  /* anything before the first header is ignored */
+   }
+   bigstring[strcspn(bigstring,"\r\n")] = '\0';
+   len = strcspn(&bigstring[1],gbl_hi);
+   if(!len)insane("fastaselecth: fatal error: -diff: header without a name");
+   *name = malloc(len + 1);
+   if(!*name)insane("fastaselecth: fatal error: could not allocate memory");
+   memcpy(*name, &bigstring[1], len);
+   (*name)[len] = '\0';
+
+   xxh64_reset(&st);
+   *pending = 0;
+   while(fgets(bigstring, gbl_wl + 1, fin)){
+      if(bigstring[0]=='>'){
+         *pending = 1;
+         break;
+      }
+      len = strlen(bigstring);
+      if(len && bigstring[len-1]=='\n'){
+         len--;
+      }
+      else if(!feof(fin)){
+         (void) fprintf(stderr,"fastaselecth: fatal error: input record in fasta file exceeds %d characters\n",gbl_wl);
+         exit(EXIT_FAILURE);
+      }
+      if(len && bigstring[len-1]=='\r')len--;
+      xxh64_update(&st, bigstring, len);
+   }
+   *hash = xxh64_digest(&st);
+   return(1);
+}
+
+/* -diff.  Every record of fname_a is reduced to its name and sequence hash and held in memory,
+   then fname_b is streamed and each of its records looked up.  Written to -out, one per line:
+      <  name     only in fname_a
+      >  name     only in fname_b
+      !  name     in both, the sequences differ
+   Lines for fname_b come in its order, then those only in fname_a, in its order.  Exits with
+   EXIT_FAILURE when any line was written, as diff(1) does, else EXIT_SUCCESS.
+*/
+void diff_files(char *fname_a, char *fname_b, char *bigstring){
+   FILE     *fin;
+   FILE     *fout;
+   char    **names=NULL;
+   uint64_t *hashes=NULL;
+   int      *order;
+   int      *sorted;
+   unsigned char *seen;
+   char     *name;
+   uint64_t  hash;
+   int       pending;
+   int       n=0;
+   int       maxn=DEFENTRIES;
+   int       i;
+   unsigned long long only_a=0;
+   unsigned long long only_b=0;
+   unsigned long long changed=0;
+   unsigned long long same=0;
+
+   names  = malloc(maxn * sizeof(char *));
+   hashes = malloc(maxn * sizeof(uint64_t));
+   if(!names || !hashes)insane("fastaselecth: fatal error: could not allocate memory");
+   fin = open_in(fname_a);
+   if(!fin)insane("fastaselecth: fatal error: -diff: could not open the first file");
+   pending = 0;
+   while(diff_next(fin, bigstring, &pending, &name, &hash)){
+      if(n >= maxn){
+         if(maxn > INT_MAX/2)insane("fastaselecth: fatal error: -diff: too many records");
+         maxn *= 2;
+         names  = realloc(names,  maxn * sizeof(char *));
+         hashes = realloc(hashes, maxn * sizeof(uint64_t));
+         if(!names || !hashes)insane("fastaselecth: fatal error: could not allocate memory");
+      }
+      names[n]  = name;
+      hashes[n] = hash;
+      n++;
+   }
+   close_in(fin);
+
+   /* names is sorted for bin_search, order[i] is the record number of names[i] */
+   order  = malloc((n ? n : 1) * sizeof(int));
+   sorted = malloc((n ? n : 1) * sizeof(int));
+   seen   = calloc(BITSET_BYTES(n ? n : 1),1);
+   if(!order || !sorted || !seen)insane("fastaselecth: fatal error: could not allocate memory");
+   for(i=0;i<n;i++){order[i]=i;}
+   sort_entries(names, NULL, order, n);
+   for(i=0;i<n;i++){
+      if(i && !strcmp(names[i],names[i-1])){
+         (void) fprintf(stderr,"fastaselecth: fatal error: -diff: name %s occurs more than once in %s\n",names[i],fname_a);
+         exit(EXIT_FAILURE);
+      }
+      sorted[order[i]]=i;
+   }
+
+   if(!gbl_out || !strcmp(gbl_out,"-")){
+      fout = stdout;
+   }
+   else {
+      fout = fopen(gbl_out,"w");
+      if(!fout)insane("fastaselecth: fatal error: could not open -out");
+   }
+   fin = open_in(fname_b);
+   if(!fin)insane("fastaselecth: fatal error: -diff: could not open the second file");
+   pending = 0;
+   while(diff_next(fin, bigstring, &pending, &name, &hash)){
+      i = bin_search(name, names, n);
+      if(i == -1){
+         only_b++;
+         (void) fprintf(fout,">\t%s\n",name);
+      }
+      else if(BIT_TEST(seen,i)){
+         (void) fprintf(stderr,"fastaselecth: fatal error: -diff: name %s occurs more than once in %s\n",name,fname_b);
+         exit(EXIT_FAILURE);
+      }
+      else {
+         BIT_SET(seen,i);
+         if(hashes[order[i]] != hash){
+            changed++;
+            (void) fprintf(fout,"!\t%s\n",name);
+         }
+         else {
+            same++;
+         }
+      }
+      free(name);
+   }
+   close_in(fin);
+   for(i=0;i<n;i++){
+      if(!BIT_TEST(seen,sorted[i])){
+         only_a++;
+         (void) fprintf(fout,"<\t%s\n",names[sorted[i]]);
+      }
+   }
+   if(fout!=stdout && fclose(fout))insane("fastaselecth: fatal error: could not write -out");
+   (void) fprintf(stderr,"fastaselecth: status: only in first: %llu, only in second: %llu, sequence differs: %llu, identical: %llu\n",
+      only_a, only_b, changed, same);
+   exit(only_a || only_b || changed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* -frag[acg].  Close fout, if it is a file, and open the file for group, named from -out.
+   The name is made, and the file tracked for stop_run(), when the group is first opened.
+   With -fragc and -fragg the file must not exist yet, so a group opened again is not
+   contiguous, which group_order() rules out for -fragg.
+*/
+FILE *frag_open(FILE *fout, int group){
+   char *path = gp_path[group];
+   int   first = !path;
+   if(first){
+      int plen = snprintf(NULL,0,gbl_out,gp_name[group]);
+      path = malloc(plen + 1);
+      if(!path)insane("fastaselecth: fatal error: could not allocate memory");
+      (void) snprintf(path,plen + 1,gbl_out,gp_name[group]);
+      gp_path[group] = path;
+   }
+   if(tar_out){  /* -out-tar, the name is that of an entry, nothing is opened */
+      if(!first){
+         fprintf(stderr,"fastaselecth: fatal error: file name: %s\n",path);
+         insane("fastaselecth: fatal error: -fragc mode output file already exists or noncontiguous group records");
+      }
+      return(tar_entry(path));
+   }
+   if(fout && fout!=stdout){
+      fclose(fout);
+   }
+   if(gbl_frag == FRAG_APPEND){
+       if(first)out_track(path, 1);
+       fout = fopen(path,"a");
+   }
+   else {
+       FILE *fprobe = NULL;
+       if(first){
+          out_track(path, 0);
+          fprobe = fopen(path,"r");
+       }
+       if(fprobe || !first){
+          fprintf(stderr,"fastaselecth: fatal error: file name: %s\n",path);
+          if(gbl_frag == FRAG_GROUP)insane("fastaselecth: fatal error: -fragg mode output file already exists");
+          insane("fastaselecth: fatal error: -fragc mode output file already exists or noncontiguous group records");
+       }
+       fout = fopen(path,"w");
+   }
+   if(!fout){
+      fprintf(stderr,"fastaselecth: fatal error: file name: %s\n",path);
+      insane("fastaselecth: fatal error: could not open output file in -frag mode");
+   }
+   man_file(fout, path);
+   return(fout);
+}
+
+/* -out-tar.  Open the archive fname, through zstd when the name ends in .zst, in a child
+   process reading a pipe, as open_in() does for gzip.  Each entry is written to a spool
+   file first, a tar header holds the size of what follows it.  An archive which
+   tar_close() did not finish is removed by tar_cleanup() at exit, whatever the error.
+*/
+static void tar_cleanup(void){
+   if(tar_file)(void) remove(tar_file);  /* any exit before tar_close(), a partial archive is of no use */
+}
+void tar_open(char *fname){
+   size_t len = strlen(fname);
+   tar_file = fname;
+   if(atexit(tar_cleanup))insane("fastaselecth: fatal error: could not set up -out-tar");
+   out_track(fname, 0);
+   tar_mtime = time(NULL);
+   tar_spool = tmpfile();
+   if(!tar_spool)insane("fastaselecth: fatal error: could not create a spool file for -out-tar");
+   if(len > 4 && !strcmp(fname + len - 4, ".zst")){
+      int fd[2];
+      int fz = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+      if(fz < 0)insane("fastaselecth: fatal error: could not open -out-tar");
+      (void) fflush(NULL);
+      if(pipe(fd))insane("fastaselecth: fatal error: could not create a pipe for -out-tar");
+      tar_pid = fork();
+      if(tar_pid < 0)insane("fastaselecth: fatal error: could not start zstd");
+      if(!tar_pid){
+         close(fd[1]);
+         if(dup2(fd[0], STDIN_FILENO) < 0 || dup2(fz, STDOUT_FILENO) < 0)_exit(127);
+         close(fd[0]);
+         close(fz);
+         execlp("zstd", "zstd", "-q", "-c", (char *) NULL);
+         (void) fprintf(stderr,"fastaselecth: fatal error: zstd could not be run\n");
+         _exit(127);
+      }
+      close(fd[0]);
+      close(fz);
+      (void) signal(SIGPIPE, SIG_IGN);  /* a failed zstd shows as a write error, not a silent death */
+      tar_out = fdopen(fd[1],"w");
+   }
+   else {
+      tar_out = fopen(fname,"w");
+   }
+   if(!tar_out)insane("fastaselecth: fatal error: could not open -out-tar");
+}
+
+/* Start the entry name, ending the one before it.  Returns the file to write it to. */
+FILE *tar_entry(char *name){
+   tar_end_entry();
+   (void) fflush(tar_spool);
+   if(ftruncate(fileno(tar_spool), 0))insane("fastaselecth: fatal error: could not reuse the -out-tar spool file");
+   rewind(tar_spool);
+   tar_name = name;
+   return(tar_spool);
+}
+
+/* Write a ustar header block, with a GNU long name entry before it for a name longer than
+   the 100 characters of the header.  Sizes too large for 11 octal digits are written in
+   base 256, as GNU tar does.
+*/
+void tar_header(const char *name, char type, unsigned long long size){
+   unsigned char h[512];
+   unsigned int  sum = 0;
+   size_t len = strlen(name);
+   int    i;
+   if(len > 100){
+      tar_header("././@LongLink", 'L', len + 1);
+      for(i=0;(size_t) i<=len;i+=512){
+         memset(h, 0, 512);
+         memcpy(h, name + i, (len + 1 - i < 512 ? len + 1 - i : 512));
+         if(fwrite(h,1,512,tar_out) != 512)write_failed(tar_spool, "fastaselecth: fatal error: could not write -out-tar");
+      }
+   }
+   memset(h, 0, 512);
+   memcpy(h, name, (len < 100 ? len : 100));
+   (void) sprintf((char *) h + 100, "%07o", 0644);
+   (void) sprintf((char *) h + 108, "%07o", 0);
+   (void) sprintf((char *) h + 116, "%07o", 0);
+   if(size < 077777777777ULL){
+      (void) sprintf((char *) h + 124, "%011llo", size);
+   }
+   else {
+      h[124] = 0x80;
+      for(i=135;i>124;i--){
+         h[i] = size & 0xff;
+         size >>= 8;
+      }
+   }
+   (void) sprintf((char *) h + 136, "%011llo", (unsigned long long) tar_mtime);
+   h[156] = type;
+   memcpy(h + 257, "ustar", 6);
+   memcpy(h + 263, "00", 2);
+   memset(h + 148, ' ', 8);
+   for(i=0;i<512;i++){ sum += h[i]; }
+   (void) sprintf((char *) h + 148, "%06o", sum);
+   h[155] = ' ';
+   if(fwrite(h,1,512,tar_out) != 512)write_failed(tar_spool, "fastaselecth: fatal error: could not write -out-tar");
+}
+
+/* Copy the open entry, if any, from the spool file into the archive. */
+void tar_end_entry(void){
+   char   buf[65536];
+   off_t  size;
+   size_t n;
+   if(!tar_name)return;
+   if(fflush(tar_spool))write_failed(tar_spool, "fastaselecth: fatal error: could not write the -out-tar spool file");
+   size = ftello(tar_spool);
+   tar_header(tar_name, '0', (unsigned long long) size);
+   rewind(tar_spool);
+   while((n = fread(buf, 1, sizeof(buf), tar_spool))){
+      if(fwrite(buf,1,n,tar_out) != n)write_failed(tar_spool, "fastaselecth: fatal error: could not write -out-tar");
+   }
+   if(size % 512){
+      memset(buf, 0, 512);
+      n = 512 - size % 512;
+      if(fwrite(buf,1,n,tar_out) != n)write_failed(tar_spool, "fastaselecth: fatal error: could not write -out-tar");
+   }
+   tar_name = NULL;
+}
+
+/* End the last entry and the archive, two zero blocks, and wait for zstd. */
+void tar_close(void){
+   char zero[1024];
+   int  status;
+   int  bad;
+   tar_end_entry();
+   memset(zero, 0, sizeof(zero));
+   bad = (fwrite(zero,1,sizeof(zero),tar_out) != sizeof(zero));
+   if(fclose(tar_out))bad = 1;
+   tar_out = NULL;
+   if(bad)write_failed(tar_spool, "fastaselecth: fatal error: could not write -out-tar");
+   fclose(tar_spool);
+   tar_spool = NULL;
+   if(tar_pid){
+      if(waitpid(tar_pid, &status, 0) < 0 || !(WIFEXITED(status) && WEXITSTATUS(status) == 0)){
+         insane("fastaselecth: fatal error: zstd failed on -out-tar");
+      }
+      tar_pid = 0;
+   }
+   tar_file = NULL;  /* complete, kept */
+}
+
+/* UCSC .2bit input.  The file starts with a signature, version, record count and a
+   reserved word, then an index of name length (1 byte), name and record offset.
+   Each record is: base count, N block count, starts and sizes, mask block count,
+   starts and sizes, reserved word, then 4 bases per byte, T C A G as 0-3, first base
+   in the high bits.  Words are 32 bits in the byte order of the writer, the signature
+   tells which.  Version 1 files have 64 bit record offsets.
+*/
+unsigned int twobit_u32(TWOBIT *tb){
+   unsigned char b[4];
+   if(fread(b,1,4,tb->fin) != 4)insane("fastaselecth: fatal error: .2bit -in is truncated");
+   if(tb->swap){
+      return( ((unsigned int) b[0] << 24) | ((unsigned int) b[1] << 16) | ((unsigned int) b[2] << 8) | b[3]);
+   }
+   return( ((unsigned int) b[3] << 24) | ((unsigned int) b[2] << 16) | ((unsigned int) b[1] << 8) | b[0]);
+}
+
+/* If fin is a .2bit file read its index and return it, else rewind fin and return NULL.
+   Only regular files are probed, so a pipe is left alone.
+*/
+TWOBIT *twobit_open(FILE *fin){
+   struct stat sb;
+   unsigned char magic[4];
+   unsigned int  word;
+   TWOBIT *tb;
+   int  i,k;
+   int  c;
+
+   if(fstat(fileno(fin),&sb) || !S_ISREG(sb.st_mode))return(NULL);
+   if(fread(magic,1,4,fin) != 4 ||
+      ((magic[0]!=0x43 || magic[1]!=0x27 || magic[2]!=0x41 || magic[3]!=0x1A) &&
+       (magic[0]!=0x1A || magic[1]!=0x41 || magic[2]!=0x27 || magic[3]!=0x43))){
+      if(fseeko(fin, 0, SEEK_SET))insane("fastaselecth: fatal error: could not rewind -in");
+      return(NULL);
+   }
+   tb = calloc(1,sizeof(TWOBIT));
+   if(!tb)insane("fastaselecth: fatal error: could not allocate memory");
+   tb->fin  = fin;
+   tb->swap = (magic[0] == 0x1A);    /* written big endian */
+   tb->version = twobit_u32(tb);
+   if(tb->version > 1)insane("fastaselecth: fatal error: .2bit -in has an unknown version");
+   word = twobit_u32(tb);
+   if(word > INT_MAX)insane("fastaselecth: fatal error: .2bit -in has too many records");
+   tb->n = word;
+   (void) twobit_u32(tb);            /* reserved */
+
+   tb->fnames  = malloc((tb->n + 1) * sizeof(char *));
+   tb->names   = malloc((tb->n + 1) * sizeof(char *));
+   tb->order   = malloc((tb->n + 1) * sizeof(int));
+   tb->offsets = malloc((tb->n + 1) * sizeof(unsigned long long));
+   tb->pbuf    = malloc(TWOBIT_CHUNK / 4);
+   tb->sbuf    = malloc(TWOBIT_CHUNK);
+   tb->obuf    = malloc(TWOBIT_CHUNK + TWOBIT_CHUNK / TWOBIT_LINE);
+   if(!tb->fnames || !tb->names || !tb->order || !tb->offsets || !tb->pbuf || !tb->sbuf || !tb->obuf){
+      insane("fastaselecth: fatal error: could not allocate memory");
+   }
+   for(i=0;i<tb->n;i++){
+      if((c = getc(fin)) == EOF)insane("fastaselecth: fatal error: .2bit -in is truncated");
+      tb->fnames[i] = malloc(c + 1);
+      if(!tb->fnames[i])insane("fastaselecth: fatal error: could not allocate memory");
+      if(fread(tb->fnames[i],1,c,fin) != (size_t) c)insane("fastaselecth: fatal error: .2bit -in is truncated");
+      tb->fnames[i][c] = '\0';
+      tb->offsets[i] = twobit_u32(tb);
+      if(tb->version == 1){  /* 64 bits, low word first in the file's order */
+         unsigned long long high = twobit_u32(tb);
+         if(tb->swap){
+            tb->offsets[i] = (tb->offsets[i] << 32) | high;
+         }
+         else {
+            tb->offsets[i] |= high << 32;
+         }
+      }
+      tb->names[i] = tb->fnames[i];
+      tb->order[i] = i;
+   }
+   sort_entries(tb->names, NULL, tb->order, tb->n);
+   for(i=1;i<tb->n;i++){
+      if(!strcmp(tb->names[i-1],tb->names[i])){
+         (void) fprintf(stderr,"fastaselecth: at fasta header: %s\n",tb->names[i]);
+         insane("fastaselecth: fatal error: duplicate entry name in FASTA file");
+      }
+   }
+   for(i=0;i<256;i++){
+      for(k=0;k<4;k++){
+         tb_bases[i][k] = "TCAG"[(i >> (6 - 2*k)) & 3];
+      }
+   }
+   return(tb);
+}
+
+/* -build-cache helpers: append one 32 bit word to f in the byte order twobit_open() expects
+   when no swap is needed, and a growing list of (start,size) runs */
+static void tbw_u32(FILE *f, unsigned long long v){
+   unsigned char b[4];
+   b[0] = v & 0xFF;
+   b[1] = (v >> 8) & 0xFF;
+   b[2] = (v >> 16) & 0xFF;
+   b[3] = (v >> 24) & 0xFF;
+   if(fwrite(b,1,4,f) != 4)insane("fastaselecth: fatal error: could not write -build-cache");
+}
+static void tbw_run(unsigned int **runs, size_t *nruns, size_t *maxruns, unsigned int start, unsigned int size){
+   if(*nruns + 2 > *maxruns){
+      *maxruns = (*maxruns ? 2 * *maxruns : 1024);
+      *runs = realloc(*runs, *maxruns * sizeof(unsigned int));
+      if(!*runs)insane("fastaselecth: fatal error: could not allocate memory");
+   }
+   (*runs)[(*nruns)++] = start;
+   (*runs)[(*nruns)++] = size;
+}
+
+/* -build-cache.  Write the DNA fasta fin to fname as a .2bit file, see twobit_open().
+   A header scan collects the names so that the index can be sized, then each record is
+   packed in memory, with its N and lowercase runs, and written.  Room for an index with
+   64 bit offsets is reserved and it is written at the end, as version 0 when all offsets
+   fit in 32 bits, which leaves an unused gap before the first record.  Anything but ACGTN in either case is fatal: .2bit keeps only
+   those, and the cache must give back exactly the bases of fin.  The file is written as
+   fname.partial and renamed when complete, so that a run which is stopped or fails never
+   leaves a truncated cache under fname for later runs to read, and the partial file is
+   removed on a fatal error or a SIGINT or SIGTERM, checked at each block.  Exits.
+*/
+static char *cache_partial=NULL;   /* name of the -build-cache file being written */
+static void cache_cleanup(void){
+   if(cache_partial)(void) remove(cache_partial);
+}
+static void cache_stop(FILE *fout){
+   if(fout)(void) fclose(fout);
+   (void) fprintf(stderr,"fastaselecth: cancelled by signal %d, -build-cache not written\n",(int) stop_signal);
+   exit(128 + stop_signal);  /* cache_cleanup() removes the partial file */
+}
+void build_cache(FILE *fin, char *fname){
+   FILE   *fout;
+   char   *header;
+   char  **names=NULL;
+   size_t  klen;
+   int     n=0;
+   int     maxn=DEFENTRIES;
+   int     rec;
+   int    *order;
+   int     i;
+   unsigned long long offset;
+   unsigned long long *offsets;
+   unsigned long long index_start, body;
+   unsigned long long bases=0;
+   unsigned long long nruns_all=0, mruns_all=0;
+   signed char code[256];          /* 0-3 for TCAG, 4 for N, -1 not allowed, either case */
+   unsigned char *packed=NULL;
+   size_t  maxpacked=0;
+   unsigned int *nruns=NULL, *mruns=NULL;
+   size_t  nn=0, maxnn=0, nm=0, maxnm=0;
+   unsigned long long len=0;       /* bases in the current record */
+   unsigned long long nstart=0, mstart=0;
+   int     inN=0, inM=0;
+   unsigned char acc=0;
+   unsigned char *buf;
+   size_t  got, k;
+   int     bol=1, inheader=0;
+
+   /* pass 1, names only */
+   catch_stop();
+   names = malloc(maxn * sizeof(char *));
+   if(!names)insane("fastaselecth: fatal error: could not allocate memory");
+   while((header = next_header(fin,&offset))){
+      if(stop_signal)cache_stop(NULL);
+      klen = strcspn(header,gbl_hi);
+      while(klen && header[klen-1]=='\r')klen--;
+      if(!klen)insane("fastaselecth: fatal error: -build-cache: header without a name");
+      if(klen > 255){
+         (void) fprintf(stderr,"fastaselecth: fatal error: -build-cache: name longer than 255 characters: %.*s\n",(int) klen,header);
+         exit(EXIT_FAILURE);
+      }
+      if(n >= maxn){
+         if(maxn > INT_MAX/2)insane("fastaselecth: fatal error: -build-cache: too many records");
+         maxn *= 2;
+         names = realloc(names, maxn * sizeof(char *));
+         if(!names)insane("fastaselecth: fatal error: could not allocate memory");
+      }
+      names[n] = malloc(klen + 1);
+      if(!names[n])insane("fastaselecth: fatal error: could not allocate memory");
+      memcpy(names[n], header, klen);
+      names[n][klen] = '\0';
+      n++;
+   }
+   if(!n)insane("fastaselecth: fatal error: -build-cache: no records in -in");
+   offsets = malloc(n * sizeof(unsigned long long));
+   order   = malloc(n * sizeof(int));
+   if(!offsets || !order)insane("fastaselecth: fatal error: could not allocate memory");
+
+   cache_partial = malloc(strlen(fname) + sizeof(".partial"));
+   if(!cache_partial)insane("fastaselecth: fatal error: could not allocate memory");
+   (void) sprintf(cache_partial,"%s.partial",fname);
+   if(atexit(cache_cleanup))insane("fastaselecth: fatal error: could not set up -build-cache");
+   fout = fopen(cache_partial,"wb");
+   if(!fout)insane("fastaselecth: fatal error: could not open -build-cache");
+   tbw_u32(fout, TWOBIT_MAGIC);
+   tbw_u32(fout, 0);               /* version, rewritten at the end */
+   tbw_u32(fout, n);
+   tbw_u32(fout, 0);
+   index_start = 16;
+   for(body=index_start, i=0; i<n; i++){
+      body += 1 + strlen(names[i]) + 8;
+      if(fputc((int) strlen(names[i]), fout)==EOF || fputs(names[i], fout)==EOF)insane("fastaselecth: fatal error: could not write -build-cache");
+      tbw_u32(fout, 0);
+      tbw_u32(fout, 0);
+   }
+
+   /* names go into the index in file order, but must be unique */
+   {
+      char **sorted = malloc(n * sizeof(char *));
+      if(!sorted)insane("fastaselecth: fatal error: could not allocate memory");
+      for(i=0;i<n;i++){ sorted[i] = names[i]; order[i] = i; }
+      sort_entries(sorted, NULL, order, n);
+      for(i=1;i<n;i++){
+         if(!strcmp(sorted[i-1],sorted[i])){
+            (void) fprintf(stderr,"fastaselecth: at fasta header: %s\n",sorted[i]);
+            insane("fastaselecth: fatal error: duplicate entry name in FASTA file");
+         }
+      }
+      free(sorted);
+   }
+
+   for(k=0;k<256;k++){ code[k] = -1; }
+   code['T'] = code['t'] = 0;
+   code['C'] = code['c'] = 1;
+   code['A'] = code['a'] = 2;
+   code['G'] = code['g'] = 3;
+   code['N'] = code['n'] = 4;
+
+   /* pass 2, the bases */
+   if(fseeko(fin, 0, SEEK_SET))insane("fastaselecth: fatal error: could not rewind -in");
+   buf = malloc(HDRBLOCK);
+   if(!buf)insane("fastaselecth: fatal error: could not allocate memory");
+   rec = -1;
+   while(1){
+      got = fread(buf, 1, HDRBLOCK, fin);
+      if(stop_signal)cache_stop(fout);
+      for(k=0; k<=got; k++){
+         int c;
+         if(k == got){
+            if(got)break;
+            c = '>';                /* end of file, close the last record */
+            bol = 1;
+            inheader = 0;
+         }
+         else {
+            c = buf[k];
+         }
+         if(inheader){
+            if(c == '\n'){ inheader = 0; bol = 1; }
+            continue;
+         }
+         if(c == '\n'){ bol = 1; continue; }
+         if(c == '\r')continue;
+         if(bol && c == '>'){
+            if(rec >= 0){            /* finish the record */
+               if(inN)tbw_run(&nruns, &nn, &maxnn, nstart, len - nstart);
+               if(inM)tbw_run(&mruns, &nm, &maxnm, mstart, len - mstart);
+               if(len & 3)packed[len/4] = acc << (2 * (4 - (len & 3)));
+               offsets[rec] = body;
+               tbw_u32(fout, len);
+               tbw_u32(fout, nn/2);
+               for(i=0;i<(int)nn;i+=2){ tbw_u32(fout, nruns[i]); }
+               for(i=1;i<(int)nn;i+=2){ tbw_u32(fout, nruns[i]); }
+               tbw_u32(fout, nm/2);
+               for(i=0;i<(int)nm;i+=2){ tbw_u32(fout, mruns[i]); }
+               for(i=1;i<(int)nm;i+=2){ tbw_u32(fout, mruns[i]); }
+               tbw_u32(fout, 0);
+               if(fwrite(packed, 1, (len + 3)/4, fout) != (len + 3)/4)insane("fastaselecth: fatal error: could not write -build-cache");
+               body += 16 + 4*(nn + nm) + (len + 3)/4;
+               bases += len;
+               nruns_all += nn/2;
+               mruns_all += nm/2;
+            }
+            if(k == got)break;
+            rec++;
+            if(rec >= n)insane("fastaselecth: fatal programming error: -build-cache record count changed");
+            len = 0;
+            nn = nm = 0;
+            inN = inM = 0;
+            acc = 0;
+            inheader = 1;
+            bol = 0;
+            continue;
+         }
+         bol = 0;
+         if(rec < 0)insane("fastaselecth: fatal error: -build-cache: sequence before the first header");
+         if(code[c] < 0){
+            (void) fprintf(stderr,"fastaselecth: fatal error: -build-cache: record %s has character \"%c\" (0x%02x), only ACGTN can be stored\n",
+               names[rec], (isprint(c) ? c : '?'), c);
+            exit(EXIT_FAILURE);
+         }
+         if(len == 0xFFFFFFFFULL){
+            (void) fprintf(stderr,"fastaselecth: fatal error: -build-cache: record %s is too long for .2bit\n",names[rec]);
+            exit(EXIT_FAILURE);
+         }
+         if(code[c] == 4){
+            if(!inN){ inN = 1; nstart = len; }
+         }
+         else if(inN){
+            tbw_run(&nruns, &nn, &maxnn, nstart, len - nstart);
+            inN = 0;
+         }
+         if(c & 0x20){
+            if(!inM){ inM = 1; mstart = len; }
+         }
+         else if(inM){
+            tbw_run(&mruns, &nm, &maxnm, mstart, len - mstart);
+            inM = 0;
+         }
+         acc = (acc << 2) | (code[c] & 3);   /* N is stored as T */
+         len++;
+         if(!(len & 3)){
+            if(len/4 > maxpacked){
+               maxpacked = (maxpacked ? 2 * maxpacked : 1048576);
+               packed = realloc(packed, maxpacked);
+               if(!packed)insane("fastaselecth: fatal error: could not allocate memory");
+            }
+            packed[len/4 - 1] = acc;
+         }
+         else if(len/4 >= maxpacked){        /* room for the partial byte at the end */
+            maxpacked = (maxpacked ? 2 * maxpacked : 1048576);
+            packed = realloc(packed, maxpacked);
+            if(!packed)insane("fastaselecth: fatal error: could not allocate memory");
+         }
+      }
+      if(!got)break;
+   }
+   if(ferror(fin))insane("fastaselecth: fatal error: could not read -in");
+   if(rec != n - 1)insane("fastaselecth: fatal programming error: -build-cache record count changed");
+
+   /* fill in the index */
+   if(fseeko(fout, 4, SEEK_SET))insane("fastaselecth: fatal error: could not seek in -build-cache");
+   tbw_u32(fout, (offsets[n-1] > 0xFFFFFFFFULL ? 1 : 0));
+   if(fseeko(fout, (off_t) index_start, SEEK_SET))insane("fastaselecth: fatal error: could not seek in -build-cache");
+   for(i=0;i<n;i++){
+      if(fputc((int) strlen(names[i]), fout)==EOF || fputs(names[i], fout)==EOF)insane("fastaselecth: fatal error: could not write -build-cache");
+      tbw_u32(fout, offsets[i] & 0xFFFFFFFFULL);
+      if(offsets[n-1] > 0xFFFFFFFFULL)tbw_u32(fout, offsets[i] >> 32);
+   }
+   if(fclose(fout))insane("fastaselecth: fatal error: could not write -build-cache");
+   if(rename(cache_partial, fname))insane("fastaselecth: fatal error: could not rename -build-cache into place");
+   free(cache_partial);
+   cache_partial = NULL;
+   (void) fprintf(stderr,"fastaselecth: status: records: %d, bases: %llu, N runs: %llu, lowercase runs: %llu\n",
+      n, bases, nruns_all, mruns_all);
+   for(i=0;i<n;i++){ free(names[i]); }
+   free(names);
+   free(offsets);
+   free(order);
+   free(packed);
+   free(nruns);
+   free(mruns);
+   free(buf);
+   exit(EXIT_SUCCESS);
+}
+
+/* file order index of the record called name, or -1 */
+int twobit_find(TWOBIT *tb, char *name){
+   int i = bin_search(name, tb->names, tb->n);
+   return(i == -1 ? -1 : tb->order[i]);
+}
+
+/* Write record rec of tb to fout: the header line, which starts with >, then the bases,
+   TWOBIT_LINE to a line, with N blocks and soft masking (lowercase) restored.  With
+   -out-format only the base count is read.  st, if not NULL, gets -stats-seq counts.
+*/
+void twobit_emit(TWOBIT *tb, int rec, char *header, FILE *fout, SEQSTATS *st){
+   unsigned int  len;
+   unsigned int  nblocks, mblocks;
+   unsigned int *nstart=NULL, *nsize=NULL, *mstart=NULL, *msize=NULL;
+   unsigned int  pos, cnt, nbytes, k, b, e;
+   unsigned int  ni=0, mi=0;
+   size_t        o;
+
+   if(fseeko(tb->fin, (off_t) tb->offsets[rec], SEEK_SET))insane("fastaselecth: fatal error: could not seek in .2bit -in");
+   len = twobit_u32(tb);
+   if(gbl_outfmt){
+      char *meta = format_meta(header + 1, tb->offsets[rec], 0, len, 0, 0);
+      (void) fprintf(fout,"%s",meta);
+      free(meta);
+      return;
+   }
+   nblocks = twobit_u32(tb);
+   nstart  = malloc((nblocks + 1) * sizeof(unsigned int));
+   nsize   = malloc((nblocks + 1) * sizeof(unsigned int));
+   if(!nstart || !nsize)insane("fastaselecth: fatal error: could not allocate memory");
+   for(k=0;k<nblocks;k++){ nstart[k] = twobit_u32(tb); }
+   for(k=0;k<nblocks;k++){ nsize[k]  = twobit_u32(tb); }
+   mblocks = twobit_u32(tb);
+   mstart  = malloc((mblocks + 1) * sizeof(unsigned int));
+   msize   = malloc((mblocks + 1) * sizeof(unsigned int));
+   if(!mstart || !msize)insane("fastaselecth: fatal error: could not allocate memory");
+   for(k=0;k<mblocks;k++){ mstart[k] = twobit_u32(tb); }
+   for(k=0;k<mblocks;k++){ msize[k]  = twobit_u32(tb); }
+   (void) twobit_u32(tb);            /* reserved */
+
+   (void) fprintf(fout,"%s\n",header);
+   man_begin(header);
+   man_add(header, strlen(header));
+   man_add("\n", 1);
+   if(st)stats_header(st);
+   for(pos=0; pos<len; pos+=cnt){
+      if(stop_signal)break;  /* the caller stops at its next record, through stop_run() */
+      cnt    = (len - pos < TWOBIT_CHUNK ? len - pos : TWOBIT_CHUNK);
+      nbytes = (cnt + 3) / 4;
+      if(fread(tb->pbuf,1,nbytes,tb->fin) != nbytes){
+         if(stop_signal)break;
+         insane("fastaselecth: fatal error: .2bit -in is truncated");
+      }
+      for(k=0;k<nbytes;k++){
+         memcpy(&tb->sbuf[4*k], tb_bases[tb->pbuf[k]], 4);
+      }
+      /* blocks are in ascending order, skip those which end before this chunk */
+      while(ni < nblocks && (unsigned long long) nstart[ni] + nsize[ni] <= pos)ni++;
+      for(k=ni; k<nblocks && nstart[k] < pos + cnt; k++){
+         b = (nstart[k] > pos ? nstart[k] - pos : 0);
+         e = ((unsigned long long) nstart[k] + nsize[k] - pos < cnt ? nstart[k] + nsize[k] - pos : cnt);
+         memset(&tb->sbuf[b], 'N', e - b);
+      }
+      while(mi < mblocks && (unsigned long long) mstart[mi] + msize[mi] <= pos)mi++;
+      for(k=mi; k<mblocks && mstart[k] < pos + cnt; k++){
+         b = (mstart[k] > pos ? mstart[k] - pos : 0);
+         e = ((unsigned long long) mstart[k] + msize[k] - pos < cnt ? mstart[k] + msize[k] - pos : cnt);
+         for(; b<e; b++){ tb->sbuf[b] |= 0x20; }  /* ACGTN to lower case */
+      }
+      for(o=0,k=0; k<cnt; k+=TWOBIT_LINE){
+         b = (cnt - k < TWOBIT_LINE ? cnt - k : TWOBIT_LINE);
+         memcpy(&tb->obuf[o], &tb->sbuf[k], b);
+         if(st)stats_line(st, &tb->sbuf[k], b);
+         o += b;
+         tb->obuf[o++] = '\n';
+      }
+      if(fwrite(tb->obuf,1,o,fout) != o)write_failed(fout, "fastaselecth: fatal error: could not write -out");
+      man_add(tb->obuf, o);
+   }
+   man_end();
+   free(nstart);
+   free(nsize);
+   free(mstart);
+   free(msize);
+}
+
+void twobit_free(TWOBIT *tb){
+   int i;
+   for(i=0;i<tb->n;i++){ free(tb->fnames[i]); }
+   free(tb->fnames);
+   free(tb->names);
+   free(tb->order);
+   free(tb->offsets);
+   free(tb->pbuf);
+   free(tb->sbuf);
+   free(tb->obuf);
+   free(tb);
+}
+
+/* Open fname for reading.  A file starting with the gzip signature is read through a
+   decompressor instead, in a child process writing to a pipe, so decompression and the
+   scan run on separate cores.  rapidgzip, which decompresses a single gzip stream in
+   parallel, is tried first, then pigz, then gzip, with a warning when rapidgzip is missing
+   as the run will be slower.  Only one such file is open at a time.
+*/
+FILE *open_in(char *fname){
+   struct stat sb;
+   FILE *fin;
+   int   fd[2];
+   int   c1, c2;
+
+   fin = fopen(fname,"r");
+   if(!fin)return(NULL);
+   if(fstat(fileno(fin),&sb) || !S_ISREG(sb.st_mode))return(fin);
+   c1 = getc(fin);
+   c2 = getc(fin);
+   if(fseeko(fin, 0, SEEK_SET))insane("fastaselecth: fatal error: could not rewind -in");
+   if(c1 != 0x1f || c2 != 0x8b)return(fin);
+   fclose(fin);
+
+   if(in_pid)insane("fastaselecth: fatal programming error: second compressed input opened");
+   (void) fflush(NULL);
+   if(pipe(fd))insane("fastaselecth: fatal error: could not create a pipe for a compressed input");
+   in_pid = fork();
+   if(in_pid < 0)insane("fastaselecth: fatal error: could not start a decompressor");
+   if(!in_pid){
+      close(fd[0]);
+      if(dup2(fd[1], STDOUT_FILENO) < 0)_exit(127);
+      close(fd[1]);
+      execlp("rapidgzip", "rapidgzip", "-d", "-c", fname, (char *) NULL);
+      (void) fprintf(stderr,"fastaselecth: warning: rapidgzip could not be run, decompressing -in with pigz or gzip, which is slower\n");
+      execlp("pigz",      "pigz",      "-d", "-c", fname, (char *) NULL);
+      execlp("gzip",      "gzip",      "-d", "-c", fname, (char *) NULL);
+      (void) fprintf(stderr,"fastaselecth: fatal error: none of rapidgzip, pigz or gzip could be run\n");
+      _exit(127);
+   }
+   close(fd[1]);
+   fin = fdopen(fd[0],"r");
+   if(!fin)insane("fastaselecth: fatal error: could not read from the decompressor");
+   return(fin);
+}
+
+/* Close a file from open_in().  When a decompressed file was read to its end the
+   decompressor must have succeeded, otherwise the input was damaged.  If reading stopped
+   early the decompressor is simply killed by the closed pipe.
+*/
+void close_in(FILE *fin){
+   int whole = feof(fin);
+   int status;
+
+   fclose(fin);
+   if(!in_pid)return;
+   if(waitpid(in_pid, &status, 0) < 0)insane("fastaselecth: fatal error: lost the decompressor");
+   in_pid = 0;
+   if(whole && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)){
+      insane("fastaselecth: fatal error: decompression of a compressed input failed");
+   }
+}
+
+/* -manifest.  The writer reports each emitted record here as it goes out: man_begin() with
+   the record, or at least its header line, then man_add() for every byte written, then
+   man_end(), or another man_begin().  man_file() is called whenever the output file
+   changes.  One line per record is written: name, output file, byte offset in that
+   file, length and XXH64 of the bytes, in hex.  All of these do nothing without -manifest.
+*/
+void man_file(FILE *fout, char *fname){
+   struct stat sb;
+   if(!mf_out)return;
+   man_end();
+   mf_file = fname;
+   /* appending, -fraga or >>, continues after what is there */
+   mf_pos  = (!fstat(fileno(fout),&sb) && S_ISREG(sb.st_mode) ? (unsigned long long) sb.st_size : 0);
+}
+void man_begin(const char *record){
+   size_t klen;
+   size_t eol;
+   if(!mf_out)return;
+   man_end();
+   klen = strcspn(record + 1, gbl_hi);
+   eol  = strcspn(record + 1, "\r\n");
+   if(eol < klen)klen = eol;
+   if(klen + 1 > mf_keymax){
+      mf_keymax = klen + 256;
+      mf_key = realloc(mf_key, mf_keymax);
+      if(!mf_key)insane("fastaselecth: fatal error: could not allocate memory");
+   }
+   memcpy(mf_key, record + 1, klen);
+   mf_key[klen] = '\0';
+   mf_start = mf_pos;
+   xxh64_reset(&mf_hash);
+}
+void man_add(const char *data, size_t len){
+   if(!mf_out || !mf_key)return;
+   xxh64_update(&mf_hash, data, len);
+   mf_pos += len;
+}
+void man_end(void){
+   if(!mf_out || !mf_key)return;
+   (void) fprintf(mf_out,"%s\t%s\t%llu\t%llu\t%016llx\n", mf_key, mf_file, mf_start, mf_pos - mf_start,
+      (unsigned long long) xxh64_digest(&mf_hash));
+   free(mf_key);
+   mf_key = NULL;
+   mf_keymax = 0;
+}
+/* a whole record written in one piece */
+void man_record(const char *record, size_t len){
+   if(!mf_out)return;
+   man_begin(record);
+   man_add(record, len);
+   man_end();
+}
+
+/* -skip and -head.  Called for each record as it is about to be written, in output order,
+   page_take() says whether it is written or skipped.  Once page_full() the scan can stop.
+*/
+static unsigned long long page_seen=0;
+static unsigned long long page_out=0;
+int page_take(void){
+   page_seen++;
+   if(page_seen <= (unsigned long long) gbl_skip)return(0);
+   if(gbl_head && page_out >= (unsigned long long) gbl_head)return(0);
+   page_out++;
+   return(1);
+}
+int page_full(void){
+   return(gbl_head && page_out >= (unsigned long long) gbl_head);
+}
+
+/* Cancellation.  on_stop() only notes the signal, the scan checks stop_signal at each record
+   and each block it reads, twobit_emit() and shmidx_emit() at each piece they copy, and
+   stop_run() then undoes the outputs listed by out_track() as each was opened.
+*/
+void on_stop(int sig){
+   stop_signal = sig;
+}
+void catch_stop(void){
+   /* no SA_RESTART, so that a read waiting on a pipe returns at once */
+   struct sigaction sa;
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler = on_stop;
+   sigemptyset(&sa.sa_mask);
+   (void) sigaction(SIGINT, &sa, NULL);
+   (void) sigaction(SIGTERM, &sa, NULL);
+}
+void out_track(const char *name, int append){
+   struct stat sb;
+   int i;
+   if(append){  /* -fraga may reopen a file, keep its first size */
+      for(i=0;i<out_num;i++){
+         if(!strcmp(out_name[i],name))return;
+      }
+   }
+   if(out_num == out_max){
+      out_max = (out_max ? 2*out_max : 64);
+      out_name = realloc(out_name, out_max*sizeof(char *));
+      out_size = realloc(out_size, out_max*sizeof(off_t));
+      if(!out_name || !out_size)insane("fastaselecth: fatal error: could not allocate memory");
+   }
+   out_name[out_num] = lcl_strdup(name);
+   out_size[out_num] = (append && !stat(name,&sb) ? sb.st_size : -1);
+   out_num++;
+}
+void stop_run(FILE *fout, int entrynum, unsigned long long records, unsigned long long emitted){
+   int i;
+   if(fout!=stdout){
+      (void) fclose(fout);
+   }
+   else {
+      (void) fflush(stdout);
+   }
+   if(mf_out){
+      (void) fclose(mf_out);
+      mf_out = NULL;
+   }
+   if(tar_out){  /* fout was the spool file */
+      (void) fclose(tar_out);
+      tar_out = NULL;
+   }
+   if(tar_pid){
+      (void) waitpid(tar_pid, NULL, 0);
+      tar_pid = 0;
+   }
+   for(i=0;i<out_num;i++){
+      if(out_size[i] < 0){
+         (void) remove(out_name[i]);
+      }
+      else if(truncate(out_name[i], out_size[i])){
+         (void) fprintf(stderr,"fastaselecth: warning: could not cut %s back to its original size\n",out_name[i]);
+      }
+   }
+   if(gbl_skip || gbl_head)emitted = page_out;
+   if(entrynum >= 0){  /* -1 from write_failed(), which has no counts */
+      (void) fprintf(stderr,"fastaselecth: status: selectors: %d, records read: %llu, emitted: %llu\n",entrynum, records,emitted);
+   }
+   (void) fprintf(stderr,"fastaselecth: cancelled by signal %d, %d output files removed or restored\n",(int) stop_signal, out_num);
+   exit(128 + stop_signal);
+}
+/* A write to fout failed.  Without SA_RESTART a signal can cut a write to a pipe short, then
+   the run is being cancelled and its outputs are undone as at any other stop, otherwise the
+   error is fatal.
+*/
+void write_failed(FILE *fout, char *string){
+   if(stop_signal)stop_run(fout, -1, 0, 0);
+   insane(string);
+}
+
+/* Write the held records of the -sel positions after *lastemitted, in -sel order, and release
+   them.  Stops at the first position not found yet, or with all set, at the end of the scan,
+   goes on past those.  Returns the output file, which -frag changes.
+*/
+FILE *drain(FILE *fout, char **emitstrings, int *emitgroups, int *lastemitted, int entrynum,
+   int *last_group, int all){
+   int i;
+   for(i = *lastemitted + 1; i < entrynum; i++){
+      if(!emitstrings[i]){
+         if(all)continue;
+         break;
+      }
+      /* The idea here is to emit the strings as soon as possible rather than waiting until all have
+         been collected and then doing them all at once.  This is faster since it spreads the writes
+         out over time, which can make a big difference if there are many megabytes of writes. */
+      if(page_take()){
+         if(gbl_frag && *last_group != emitgroups[i]){
+            *last_group = emitgroups[i];
+            fout = frag_open(fout, *last_group);
+         }
+         (void) fprintf(fout,"%s",emitstrings[i]);
+         man_record(emitstrings[i], strlen(emitstrings[i]));
+      }
+      free(emitstrings[i]); /* release memory */
+      emitstrings[i] = NULL;
+      *lastemitted = i;
+   }
+   return(fout);
+}
+
+/* The plain scan, for selections and rejections from a fasta -in without -out-format,
+   -stats-seq, -validate, -replace-with or header rewriting.  -in is read in blocks and
+   memchr() finds the next '>' starting a line, so a record is handled whole, its header line
+   and then its body in as few pieces as the blocks allow, rather than line by line.  Only a
+   body with '\r' in it is looked at again, to drop the '\r' of "\r\n" as the line scan does.
+   reject is a constant in scan_select() and scan_reject(), each gets its own copy of this
+   without the tests on it.  Returns 1 when the scan stopped early because everything wanted
+   was written, else 0, at the end of -in, on -head with -reject, or on a signal.
+*/
+static void scan_fill(FILE *fin, char *buf, size_t cap, size_t *pos, size_t *end, int *eof, SCANBATCH *bt){
+   size_t n = *end - *pos;
+   if(n && *pos)memmove(buf, buf + *pos, n);
+   *pos = 0;
+   *end = n + fread(buf + n, 1, cap - n, fin);
+   buf[*end] = '\0';  /* stops key_walk() */
+   if(ferror(fin)){
+      if(!stop_signal)insane("fastaselecth: fatal error: error reading -in");
+      *eof = 1;  /* a read cut short by a signal, the caller stops */
+   }
+   else if(feof(fin))*eof = 1;
+   bt->n = bt->i = 0;
+   bt->to = 0;
+}
+/* Starting at buf[pos], a '>' that starts a line, find up to SCAN_BATCH header lines in the
+   block, hash their names and prefetch their selector set slots, then the names in those
+   slots.  When the scan gets to them the lookups find these in the cache, where one by one
+   each would wait for memory in turn.  The header starts are kept, so the scan does not look
+   for them again.  A name ending at anything but a delimiter or the line end is left to
+   selset_match().  buf[end] must be '\0'.
+*/
+static void scan_batch(const char *buf, size_t pos, size_t end, SCANBATCH *bt){
+   const char *e = buf + end;
+   const char *p = buf + pos;
+   int i;
+   bt->n = bt->i = 0;
+   bt->to = pos;
+   while(bt->n < SCAN_BATCH){
+      const char *name = p + 1;
+      const char *eol;
+      const char *gt;
+      const char *next = NULL;
+      unsigned long long h;
+      size_t k = key_walk(name, line_stop, &h);
+      if(name + k >= e)break;  /* runs past the block */
+      bt->pos[bt->n] = p - buf;
+      if(!k || !name[k] || (name[k] == '\r' && name[k+1] != '\n')){
+         bt->klen[bt->n] = SIZE_MAX;
+      }
+      else {
+         bt->klen[bt->n] = k;
+         bt->hash[bt->n] = h;
+         PREFETCH(&ss_slot[h & ss_mask]);
+      }
+      bt->n++;
+      bt->to = p - buf + 1;
+      eol = memchr(name + k, '\n', e - (name + k));
+      if(!eol)break;
+      for(gt = eol + 1; gt < e && (gt = memchr(gt, '>', e - gt)); gt++){
+         if(gt[-1] == '\n'){
+            next = gt;
+            break;
+         }
+      }
+      if(!next){
+         bt->to = end;
+         break;
+      }
+      bt->to = next - buf;
+      p = next;
+   }
+   for(i=0;i<bt->n;i++){
+      if(bt->klen[i] != SIZE_MAX){
+         const SELSLOT *sl = &ss_slot[bt->hash[i] & ss_mask];
+         if(sl->hash)PREFETCH(sl->name);
+      }
+   }
+}
+static void scan_put(SCANSTATE *sc, const int reject, const char *p, size_t n){
+   if(reject){
+      if(fwrite(p, 1, n, sc->fout) != n)write_failed(sc->fout, "fastaselecth: fatal error: could not write -out");
+      man_add(p, n);
+   }
+   else {
+      if(sc->acclen + n + 1 > sc->accmax){
+         sc->accmax = 2 * (sc->acclen + n + 1);
+         sc->acc = realloc(sc->acc, sc->accmax);
+         if(!sc->acc)insane("fastaselecth: fatal error: ran out of memory during processing");
+      }
+      memcpy(sc->acc + sc->acclen, p, n);
+      sc->acclen += n;
+   }
+}
+/* last: p ends -in, so a final '\r' ends the last line */
+static void scan_body(SCANSTATE *sc, const int reject, const char *p, size_t n, int last){
+   const char *cr;
+   while(n && (cr = memchr(p, '\r', n))){
+      size_t k = cr - p;
+      if(k + 1 < n ? cr[1] != '\n' : !last){  /* not a line end, kept */
+         scan_put(sc, reject, p, k + 1);
+      }
+      else if(k){
+         scan_put(sc, reject, p, k);
+      }
+      p += k + 1;
+      n -= k + 1;
+   }
+   if(n)scan_put(sc, reject, p, n);
+}
+/* the record for selector slot is complete, hold it and write what can be */
+static int scan_keep(SCANSTATE *sc, int slot){
+   int at = sc->emitorder[slot];
+   if(sc->emitstrings[at]!=NULL)insane("fastaselecth: fatal programming error: nonNULL storage");
+   sc->acc[sc->acclen] = '\0';
+   sc->emitstrings[at] = realloc(sc->acc, sc->acclen + 1);
+   if(!sc->emitstrings[at])sc->emitstrings[at] = sc->acc;
+   sc->acc = NULL;
+   sc->acclen = sc->accmax = 0;
+   sc->fout = drain(sc->fout, sc->emitstrings, sc->emitgroups, &sc->lastemitted, sc->entrynum,
+      &sc->last_group, 0);
+   return(page_full() || sc->lastemitted == sc->entrynum - 1);
+}
+static inline int scan_plain(SCANSTATE *sc, const int reject){
+   size_t cap = SCAN_BLOCK + (size_t) gbl_wl + 2;
+   char  *buf = malloc(cap + 1);
+   SCANBATCH bt;
+   size_t pos = 0;
+   size_t end = 0;
+   int    eof = 0;
+   int    bol = 1;                 /* buf[pos] starts a line */
+   int    emit = 0;
+   int    slot = -1;
+   int    ret = 0;
+   int    at_end = 0;
+   char   lastc = '\n';
+   if(!buf)insane("fastaselecth: fatal error: could not allocate memory");
+   bt.n = bt.i = 0;
+   bt.to = 0;
+
+   while(1){
+      if(pos == end){
+         if(!eof)scan_fill(sc->fin, buf, cap, &pos, &end, &eof, &bt);
+         if(stop_signal)break;  /* at each block, so a long record does not delay it */
+         if(pos == end){
+            at_end = 1;
+            break;
+         }
+      }
+      if(bol && buf[pos] == '>'){
+         char  *nl;
+         size_t hlen;
+         size_t hpos;
+         int    matched;
+         while(!(nl = memchr(buf + pos, '\n', end - pos)) && !eof && end - pos <= (size_t) gbl_wl){
+            scan_fill(sc->fin, buf, cap, &pos, &end, &eof, &bt);
+            if(stop_signal)break;
+         }
+         if(stop_signal)break;
+         hlen = (nl ? (size_t) (nl - (buf + pos)) : end - pos);
+         if(hlen + 1 > (size_t) gbl_wl){
+            (void) fprintf(stderr,"fastaselecth: fatal error: input record in fasta file exceeds %d characters\n",gbl_wl);
+            exit(EXIT_FAILURE);
+         }
+         if(!nl)(void) fprintf(stderr,"fastaselecth warning: last line of file lacks a \\n \n");
+         sc->records++;
+         if(!reject && emit){
+            ret = scan_keep(sc, slot);
+            emit = 0;
+            if(ret)break;
+         }
+         hpos = pos;
+         memcpy(sc->bigstring, buf + pos, hlen);
+         if(hlen && sc->bigstring[hlen - 1] == '\r')hlen--;
+         sc->bigstring[hlen] = '\0';
+         pos = (nl ? (size_t) (nl - buf) + 1 : end);
+         lastc = '\n';
+
+         if(bt.i == bt.n || bt.pos[bt.i] != hpos)scan_batch(buf, hpos, end, &bt);
+         if(bt.i < bt.n && bt.pos[bt.i] == hpos && bt.klen[bt.i] != SIZE_MAX){
+            matched = selset_find(buf + hpos + 1, bt.klen[bt.i], bt.hash[bt.i]);
+         }
+         else {
+            matched = selset_match(sc->bigstring + 1);
+         }
+         if(bt.i < bt.n && bt.pos[bt.i] == hpos)bt.i++;
+         if(reject){
+            if(matched != -1){
+               BIT_SET(sc->emitlist,matched);  /* for -missing-out */
+               emit = 0;
+            }
+            else if(!page_take()){
+               emit = 0;
+               if(page_full())break;
+            }
+            else {
+               emit = 1;
+               man_begin(sc->bigstring);
+            }
+         }
+         else if(matched != -1){
+            if(BIT_TEST(sc->emitlist,matched)){
+               (void) fprintf(stderr,"fastaselecth: at fasta header: %s\n",sc->bigstring + 1);
+               insane("fastaselecth: fatal error: duplicate entry name in FASTA file");
+            }
+            BIT_SET(sc->emitlist,matched);
+            if(gbl_frag){
+               if(sc->group_list[matched] == -1)insane("fastaselecth: fatal error: -frac[ac] used but one or more selectors lack second field");
+               sc->emitgroups[sc->emitorder[matched]] = sc->group_list[matched];
+            }
+            slot = matched;
+            emit = 1;
+         }
+         else {
+            emit = 0;
+         }
+         if(emit){
+            sc->emitted++;
+            scan_put(sc, reject, sc->bigstring, hlen);
+            scan_put(sc, reject, "\n", 1);
+         }
+         continue;
+      }
+
+      /* body, up to the next '>' that starts a line, buf[pos] is not one */
+      {
+         size_t stop = end;
+         char  *gt = buf + (bt.to > pos ? bt.to : pos);  /* the batch has those before bt.to */
+         int    found = 0;
+         if(bt.i < bt.n){
+            stop = bt.pos[bt.i];
+            found = 1;
+         }
+         else while(gt < buf + end && (gt = memchr(gt, '>', (buf + end) - gt))){
+            if(gt > buf + pos && gt[-1] == '\n'){
+               stop = gt - buf;
+               found = 1;
+               break;
+            }
+            gt++;
+         }
+         if(!found && !eof && buf[end - 1] == '\r'){  /* may be the start of a \r\n, wait for the rest */
+            if(end - pos == 1){
+               scan_fill(sc->fin, buf, cap, &pos, &end, &eof, &bt);
+               if(stop_signal)break;
+               continue;
+            }
+            stop--;
+         }
+         if(emit)scan_body(sc, reject, buf + pos, stop - pos, eof && stop == end);
+         lastc = buf[stop - 1];
+         bol = (lastc == '\n');
+         pos = stop;
+      }
+   }
+   if(at_end && lastc != '\n'){
+      (void) fprintf(stderr,"fastaselecth warning: last line of file lacks a \\n \n");
+      if(emit)scan_put(sc, reject, "\n", 1);
+   }
+   if(!reject && emit && !ret && !stop_signal){
+      (void) scan_keep(sc, slot);  /* the end of -in was reached, so 0 even if it was the last one */
+   }
+   free(sc->acc);
+   sc->acc = NULL;
+   free(buf);
+   return(ret);
+}
+int scan_select(SCANSTATE *sc){
+   return(scan_plain(sc, 0));
+}
+int scan_reject(SCANSTATE *sc){
+   return(scan_plain(sc, 1));
+}
+
+/* -verify.  Reread the byte ranges listed in the -manifest file fname and compare their
+   hashes.  Each problem goes to -out as name, file, and what is wrong.  Records written to
+   stdout cannot be checked and are counted as skipped.  Exits, with a failure status if
+   anything did not match.
+*/
+void verify_manifest(char *fname, char *bigstring){
+   FILE  *fm;
+   FILE  *fout;
+   FILE  *fin=NULL;
+   char  *lastfile=NULL;
+   char  *field[5];
+   char  *buf;
+   char  *bp;
+   int    i;
+   unsigned long long offset, length, want, got;
+   unsigned long long checked=0, bad=0, skipped=0;
+   size_t n;
+   XXH64STATE st;
+
+   fm = fopen(fname,"r");
+   if(!fm)insane("fastaselecth: fatal error: could not open -verify");
+   if(!gbl_out || !strcmp(gbl_out,"-")){
+      fout = stdout;
+   }
+   else {
+      fout = fopen(gbl_out,"w");
+      if(!fout)insane("fastaselecth: fatal error: could not open -out");
+   }
+   buf = malloc(HDRBLOCK);
+   if(!buf)insane("fastaselecth: fatal error: could not allocate memory");
+   while(fgets(bigstring, gbl_wl + 1, fm)){
+      bigstring[strcspn(bigstring,"\r\n")] = '\0';
+      if(!*bigstring)continue;
+      for(bp=bigstring, i=0; i<5; i++){
+         field[i] = bp;
+         bp = strchr(bp,'\t');
+         if(!bp && i<4){
+            (void) fprintf(stderr,"fastaselecth: fatal error: -verify: bad line: %s\n",bigstring);
+            exit(EXIT_FAILURE);
+         }
+         if(bp)*bp++ = '\0';
+      }
+      offset = strtoull(field[2], NULL, 10);
+      length = strtoull(field[3], NULL, 10);
+      want   = strtoull(field[4], NULL, 16);
+      if(!strcmp(field[1],"-")){
+         skipped++;
+         continue;
+      }
+      checked++;
+      if(!lastfile || strcmp(lastfile,field[1])){
+         if(fin)fclose(fin);
+         free(lastfile);
+         lastfile = lcl_strdup(field[1]);
+         fin = fopen(field[1],"r");
+      }
+      if(!fin){
+         bad++;
+         (void) fprintf(fout,"%s\t%s\tfile missing\n",field[0],field[1]);
+         continue;
+      }
+      xxh64_reset(&st);
+      got = 0;
+      if(!fseeko(fin, (off_t) offset, SEEK_SET)){
+         while(got < length){
+            n = fread(buf, 1, (length - got < HDRBLOCK ? length - got : HDRBLOCK), fin);
+            if(!n)break;
+            xxh64_update(&st, buf, n);
+            got += n;
+         }
+      }
+      if(got < length){
+         bad++;
+         (void) fprintf(fout,"%s\t%s\ttruncated\n",field[0],field[1]);
+      }
+      else if(xxh64_digest(&st) != want){
+         bad++;
+         (void) fprintf(fout,"%s\t%s\tchanged\n",field[0],field[1]);
+      }
+   }
+   if(fin)fclose(fin);
+   fclose(fm);
+   free(lastfile);
+   free(buf);
+   if(fout!=stdout && fclose(fout))insane("fastaselecth: fatal error: could not write -out");
+   (void) fprintf(stderr,"fastaselecth: status: records checked: %llu, bad: %llu, skipped (stdout): %llu\n",
+      checked, bad, skipped);
+   if(bad)insane("fastaselecth: fatal error: -verify found records which do not match the manifest");
+   exit(EXIT_SUCCESS);
+}
+
+/* Fingerprint of the file fname, to tell cheaply whether it has changed.
+      FPRINT_SAMPLED  XXH64 over the size, modification time to the nanosecond, inode and
+                      FPRINT_NSAMPLE blocks of FPRINT_BLOCK bytes spread over the file.  Reads
+                      at most 1 MB, and catches a rewrite which kept the mtime, as on NFS.
+      FPRINT_FULL     XXH64 over the size and the XXH64 of every FPRINT_CHUNK piece, the
+                      pieces hashed by several threads.  Depends on the content only.
+*/
+uint64_t fingerprint(char *fname, int mode){
+   struct stat sb;
+   XXH64STATE st;
+   unsigned char word[8];
+   unsigned long long v[4];
+   unsigned long long offset;
+   char  *buf;
+   ssize_t got;
+   int    fd;
+   int    i,k;
+
+   fd = open(fname, O_RDONLY);
+   if(fd < 0 || fstat(fd,&sb))insane("fastaselecth: fatal error: -fingerprint: could not open -in");
+   if(!S_ISREG(sb.st_mode))insane("fastaselecth: fatal error: -fingerprint: -in must be a regular file");
+   xxh64_reset(&st);
+   v[0] = sb.st_size;
+   v[1] = (mode == FPRINT_SAMPLED ? (unsigned long long) sb.st_mtim.tv_sec  : 0);
+   v[2] = (mode == FPRINT_SAMPLED ? (unsigned long long) sb.st_mtim.tv_nsec : 0);
+   v[3] = (mode == FPRINT_SAMPLED ? (unsigned long long) sb.st_ino : 0);
+   for(i=0;i<4;i++){  /* little endian, so the value does not depend on the machine */
+      for(k=0;k<8;k++){ word[k] = (v[i] >> (8*k)) & 0xFF; }
+      xxh64_update(&st, word, 8);
+   }
+
+   if(mode == FPRINT_SAMPLED){
+      buf = malloc(FPRINT_BLOCK);
+      if(!buf)insane("fastaselecth: fatal error: could not allocate memory");
+      int nsample = ((unsigned long long) sb.st_size <= FPRINT_BLOCK ? 1 : FPRINT_NSAMPLE);  /* small, the whole file once */
+      for(i=0;i<nsample;i++){
+         offset = 0;
+         if(nsample > 1){
+            offset = ((unsigned long long) sb.st_size - FPRINT_BLOCK) / (FPRINT_NSAMPLE - 1) * i;
+            if(i == FPRINT_NSAMPLE - 1)offset = sb.st_size - FPRINT_BLOCK;
+         }
+         got = pread(fd, buf, FPRINT_BLOCK, (off_t) offset);
+         if(got < 0)insane("fastaselecth: fatal error: -fingerprint: could not read -in");
+         xxh64_update(&st, buf, got);
+      }
+      free(buf);
+   }
+   else {
+      FPRINT_JOB  job[FPRINT_THREADS];
+      pthread_t   tid[FPRINT_THREADS];
+      unsigned long long nchunks = ((unsigned long long) sb.st_size + FPRINT_CHUNK - 1) / FPRINT_CHUNK;
+      unsigned long long c;
+      long  ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+      int   nthreads = (ncpu < 1 ? 1 : (ncpu > FPRINT_THREADS ? FPRINT_THREADS : (int) ncpu));
+      uint64_t *hashes;
+
+      if((unsigned long long) nthreads > nchunks)nthreads = (nchunks ? nchunks : 1);
+      hashes = malloc((nchunks ? nchunks : 1) * sizeof(uint64_t));
+      if(!hashes)insane("fastaselecth: fatal error: could not allocate memory");
+      for(i=0;i<nthreads;i++){
+         job[i].fd      = fd;
+         job[i].size    = sb.st_size;
+         job[i].nchunks = nchunks;
+         job[i].first   = i;
+         job[i].step    = nthreads;
+         job[i].hashes  = hashes;
+         job[i].failed  = 0;
+         if(pthread_create(&tid[i], NULL, fingerprint_worker, &job[i]))insane("fastaselecth: fatal error: could not start a thread");
+      }
+      for(i=0;i<nthreads;i++){
+         (void) pthread_join(tid[i], NULL);
+         if(job[i].failed)insane("fastaselecth: fatal error: -fingerprint: could not read -in");
+      }
+      for(c=0;c<nchunks;c++){
+         for(k=0;k<8;k++){ word[k] = (hashes[c] >> (8*k)) & 0xFF; }
+         xxh64_update(&st, word, 8);
+      }
+      free(hashes);
+   }
+   close(fd);
+   return(xxh64_digest(&st));
+}
+
+/* hash the chunks of one FPRINT_JOB, reading with pread so threads share the descriptor */
+void *fingerprint_worker(void *arg){
+   FPRINT_JOB *job = arg;
+   XXH64STATE st;
+   unsigned long long c, offset, end;
+   ssize_t got;
+   char *buf = malloc(HDRBLOCK);
+
+   if(!buf){
+      job->failed = 1;
+      return(NULL);
+   }
+   for(c=job->first; c<job->nchunks; c+=job->step){
+      xxh64_reset(&st);
+      offset = c * FPRINT_CHUNK;
+      end    = (offset + FPRINT_CHUNK < job->size ? offset + FPRINT_CHUNK : job->size);
+      while(offset < end){
+         got = pread(job->fd, buf, (end - offset < HDRBLOCK ? end - offset : HDRBLOCK), (off_t) offset);
+         if(got <= 0){
+            job->failed = 1;
+            free(buf);
+            return(NULL);
+         }
+         xxh64_update(&st, buf, got);
+         offset += got;
+      }
+      job->hashes[c] = xxh64_digest(&st);
+   }
+   free(buf);
+   return(NULL);
+}
+
+/* -shm-index.  Return the header index of fin, from the file for it in dir if there is one,
+   else built by a header scan and published there.  The file is named from the sampled
+   fingerprint of -in and from -hi, so a changed -in gets a new index; old files may be
+   deleted at any time.  A new index is written under a temporary name and renamed, so
+   other processes see all of it or nothing, and they map it read only and share its pages.
+*/
+SHMIDX *shmidx_open(char *dir, FILE *fin){
+   struct stat sb;
+   XXH64STATE st;
+   SHMIDX *ix;
+   SHMIDX_HEAD *head;
+   unsigned char word[8];
+   uint64_t key;
+   char  *path;
+   char  *tmp;
+   char  *header;
+   char **names=NULL;
+   unsigned long long *hoffsets=NULL;
+   unsigned long long offset;
+   unsigned long long poolsize=0;
+   size_t klen;
+   int   *order;
+   int    n=0, maxn=DEFENTRIES;
+   int    fd, i, k;
+
+   xxh64_reset(&st);
+   key = fingerprint(gbl_in, FPRINT_SAMPLED);
+   for(k=0;k<8;k++){ word[k] = (key >> (8*k)) & 0xFF; }
+   xxh64_update(&st, word, 8);
+   xxh64_update(&st, gbl_hi, strlen(gbl_hi));
+   key = xxh64_digest(&st);
+   path = malloc(strlen(dir) + 64);
+   tmp  = malloc(strlen(dir) + 96);
+   ix   = calloc(1,sizeof(SHMIDX));
+   if(!path || !tmp || !ix)insane("fastaselecth: fatal error: could not allocate memory");
+   (void) sprintf(path,"%s/fastaselecth-%016llx.idx",dir,(unsigned long long) key);
+
+   fd = open(path, O_RDONLY);
+   if(fd >= 0){
+      if(!fstat(fd,&sb) && (size_t) sb.st_size >= sizeof(SHMIDX_HEAD)){
+         ix->bloblen = sb.st_size;
+         ix->blob = mmap(NULL, ix->bloblen, PROT_READ, MAP_SHARED, fd, 0);
+         if(ix->blob == MAP_FAILED)ix->blob = NULL;
+      }
+      close(fd);
+      if(ix->blob){
+         head = (SHMIDX_HEAD *) ix->blob;
+         if(head->magic == SHMIDX_MAGIC && head->key == key && head->n <= INT_MAX &&
+            sizeof(SHMIDX_HEAD) + head->n * sizeof(SHMIDX_ENTRY) + head->poolsize == ix->bloblen &&
+            (!head->poolsize || !ix->blob[ix->bloblen - 1])){
+            ix->mapped = 1;
+            ix->n    = head->n;
+            ix->ent  = (SHMIDX_ENTRY *) (ix->blob + sizeof(SHMIDX_HEAD));
+            ix->pool = (char *) (ix->ent + ix->n);
+            (void) fprintf(stderr,"fastaselecth: status: using index %s\n",path);
+            free(path);
+            free(tmp);
+            return(ix);
+         }
+         (void) munmap(ix->blob, ix->bloblen);
+         ix->blob = NULL;
+      }
+      (void) fprintf(stderr,"fastaselecth: warning: ignoring damaged index %s\n",path);
+   }
+
+   /* build it */
+   names    = malloc(maxn * sizeof(char *));
+   hoffsets = malloc(maxn * sizeof(unsigned long long));
+   if(!names || !hoffsets)insane("fastaselecth: fatal error: could not allocate memory");
+   while((header = next_header(fin,&offset))){
+      klen = strcspn(header,gbl_hi);
+      while(klen && header[klen-1]=='\r')klen--;
+      if(n >= maxn){
+         if(maxn > INT_MAX/2)insane("fastaselecth: fatal error: -shm-index: too many records");
+         maxn *= 2;
+         names    = realloc(names,    maxn * sizeof(char *));
+         hoffsets = realloc(hoffsets, maxn * sizeof(unsigned long long));
+         if(!names || !hoffsets)insane("fastaselecth: fatal error: could not allocate memory");
+      }
+      names[n] = malloc(klen + 1);
+      if(!names[n])insane("fastaselecth: fatal error: could not allocate memory");
+      memcpy(names[n], header, klen);
+      names[n][klen] = '\0';
+      hoffsets[n] = offset;
+      poolsize += klen + 1;
+      n++;
+   }
+   if(fstat(fileno(fin),&sb))insane("fastaselecth: fatal error: could not stat -in");
+   order = malloc((n ? n : 1) * sizeof(int));
+   if(!order)insane("fastaselecth: fatal error: could not allocate memory");
+   for(i=0;i<n;i++){ order[i] = i; }
+   sort_entries(names, NULL, order, n);
+
+   ix->bloblen = sizeof(SHMIDX_HEAD) + n * sizeof(SHMIDX_ENTRY) + poolsize;
+   ix->blob    = malloc(ix->bloblen);
+   if(!ix->blob)insane("fastaselecth: fatal error: could not allocate memory");
+   head = (SHMIDX_HEAD *) ix->blob;
+   head->magic    = SHMIDX_MAGIC;
+   head->key      = key;
+   head->n        = n;
+   head->poolsize = poolsize;
+   ix->n    = n;
+   ix->ent  = (SHMIDX_ENTRY *) (ix->blob + sizeof(SHMIDX_HEAD));
+   ix->pool = (char *) (ix->ent + n);
+   for(offset=0, i=0; i<n; i++){
+      ix->ent[i].name    = offset;
+      ix->ent[i].hoffset = hoffsets[order[i]];
+      ix->ent[i].end     = (order[i] + 1 < n ? hoffsets[order[i] + 1] : (unsigned long long) sb.st_size);
+      ix->ent[i].dup     = ((i && !strcmp(names[i-1],names[i])) || (i + 1 < n && !strcmp(names[i],names[i+1])));
+      strcpy(ix->pool + offset, names[i]);
+      offset += strlen(names[i]) + 1;
+   }
+   for(i=0;i<n;i++){ free(names[i]); }
+   free(names);
+   free(hoffsets);
+   free(order);
+
+   (void) sprintf(tmp,"%s.%ld",path,(long) getpid());
+   fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+   if(fd < 0 || write(fd, ix->blob, ix->bloblen) != (ssize_t) ix->bloblen || close(fd) || rename(tmp, path)){
+      (void) fprintf(stderr,"fastaselecth: warning: could not publish index %s, it is used by this run only\n",path);
+      if(fd >= 0)(void) unlink(tmp);
+   }
+   else {
+      (void) fprintf(stderr,"fastaselecth: status: index of %d records published as %s\n",n,path);
+   }
+   free(path);
+   free(tmp);
+   return(ix);
+}
+
+/* index of the entry called name, or -1 */
+long long shmidx_find(SHMIDX *ix, char *name){
+   long long bot = 0;
+   long long top = ix->n - 1;
+   long long mid;
+   int cmp;
+
+   while(bot <= top){
+      mid = (bot + top)/2;
+      cmp = strcmp(ix->pool + ix->ent[mid].name, name);
+      if(!cmp)return(mid);
+      if(cmp > 0){
+         top = mid - 1;
+      }
+      else {
+         bot = mid + 1;
+      }
+   }
+   return(-1);
+}
+
+/* Copy record i from fin to fout, with \r\n line ends written as \n and a \n added after
+   a last line without one, the same bytes the scan would write.  buf holds HDRBLOCK+1.
+*/
+void shmidx_emit(SHMIDX *ix, long long i, FILE *fin, FILE *fout, char *buf){
+   SHMIDX_ENTRY *e = &ix->ent[i];
+   char  *name = ix->pool + e->name;
+   unsigned long long remaining = e->end - e->hoffset;
+   size_t n, m, k;
+   int    first = 1;
+   int    held_cr = 0;    /* the last block ended in a \r */
+   char   last = '\n';
+
+   if(e->dup){
+      (void) fprintf(stderr,"fastaselecth: at fasta header: %s\n",name);
+      insane("fastaselecth: fatal error: duplicate entry name in FASTA file");
+   }
+   if(fseeko(fin, (off_t) e->hoffset, SEEK_SET))insane("fastaselecth: fatal error: could not seek in -in");
+   while(remaining){
+      if(stop_signal)return;  /* the caller stops at its next record, through stop_run() */
+      n = fread(buf, 1, (remaining < HDRBLOCK ? remaining : HDRBLOCK), fin);
+      if(!n){
+         if(stop_signal)return;
+         insane("fastaselecth: fatal error: -in is shorter than its -shm-index says");
+      }
+      buf[n] = '\0';
+      remaining -= n;
+      if(first){
+         k = strlen(name);
+         if(buf[0] != '>' || strncmp(buf + 1, name, k) || (buf[k+1] && !strchr(gbl_hi, buf[k+1]) && !strchr("\r\n", buf[k+1]))){
+            insane("fastaselecth: fatal error: -in does not match its -shm-index");
+         }
+         man_begin(buf);
+         first = 0;
+      }
+      if(held_cr && buf[0] != '\n'){
+         (void) fputc('\r', fout);
+         man_add("\r", 1);
+      }
+      held_cr = 0;
+      m = n;
+      if(memchr(buf, '\r', n)){
+         for(m=0, k=0; k<n; k++){
+            if(buf[k] == '\r'){
+               if(k + 1 == n){ held_cr = 1; continue; }
+               if(buf[k+1] == '\n')continue;
+            }
+            buf[m++] = buf[k];
+         }
+      }
+      if(m){
+         if(fwrite(buf, 1, m, fout) != m)write_failed(fout, "fastaselecth: fatal error: could not write -out");
+         man_add(buf, m);
+         last = buf[m-1];
+      }
+   }
+   if(last != '\n'){
+      (void) fputc('\n', fout);
+      man_add("\n", 1);
+   }
+   man_end();
+}
+
+void shmidx_free(SHMIDX *ix){
+   if(ix->mapped){
+      (void) munmap(ix->blob, ix->bloblen);
+   }
+   else {
+      free(ix->blob);
+   }
+   free(ix);
+}
+
+/* -audit-dups.  Every header name in fin goes into the keyset, reading only the header lines.
+   Each repeat is written to -out as: name, offset of the first header, offset of the repeat.
+   Exits, with a failure status if any name was repeated.
+*/
+void audit_dups(FILE *fin){
+   FILE  *fout;
+   char  *header;
+   size_t klen;
+   unsigned long long offset;
+   unsigned long long first;
+   unsigned long long records=0;
+   unsigned long long nokey=0;
+   unsigned long long dups=0;
+
+   if(!gbl_out || !strcmp(gbl_out,"-")){
+      fout = stdout;
+   }
+   else {
+      fout = fopen(gbl_out,"w");
+      if(!fout)insane("fastaselecth: fatal error: could not open -out");
    }
-   return end;
+   while((header = next_header(fin,&offset))){
+      records++;
+      klen = strcspn(header,gbl_hi);
+      if(!klen){
+         nokey++;
+         continue;
+      }
+      if(keyset_add(header, klen, offset, &first)){
+         dups++;
+         (void) fprintf(fout,"%.*s\t%llu\t%llu\n",(int) klen,header,first,offset);
+      }
+   }
+   if(fout!=stdout && fclose(fout))insane("fastaselecth: fatal error: could not write -out");
+   close_in(fin);
+   keyset_free();
+   (void) fprintf(stderr,"fastaselecth: status: records read: %llu, distinct names: %llu, repeated names: %llu, headers without name: %llu\n",
+      records, records - dups - nokey, dups, nokey);
+   if(dups){
+      insane("fastaselecth: fatal error: -audit-dups found repeated header names");
+   }
+   exit(EXIT_SUCCESS);
 }
 
+/* -count and -check.  Only the header lines of fin are read and nothing is buffered
+   or written to -out.  -check lists every selector, in -sel order, with the number
+   of records it matched.  -count gives the totals.  Exits.
+*/
+void count_selectors(FILE *fin, char **header_name_list, int *emitorder, int entrynum){
+   char  *header;
+   size_t b_num_chars;
+   unsigned long long h;
+   int    matched;
+   int    i;
+   int    found=0;
+   int    multiple=0;
+   unsigned long long offset;
+   unsigned long long records=0;
+   unsigned long long hits=0;
+   unsigned long long emitted;
 
-/* modified combsort with restart capability - keeps sort from
-degenerating into bubble sort on toxic data */
-void sort_entries(char **header_name_list, char **group_name_list, int *order, int entrynum){
-int done,gap,swaps;
-int restart=0;
-int i,j;
-char *temp;
-float shrink;
-int itemp;
+   unsigned int *counts=calloc(entrynum,sizeof(unsigned int));
+   if(!counts)insane("fastaselecth: fatal error: could not allocate memory");
 
-  shrink=1.3;
-  for(done=0; !done; ){
-    gap = (entrynum/2) - 1;
-    if(gap<1)gap=1;
-    for( ;gap>=1;gap/=shrink){
-      if(gap<1)gap=1;
-      swaps=0;
-      for(i=0,j=gap;j<entrynum;i++,j++){
-        if(strcmp(header_name_list[j],header_name_list[i])<0){
-          swaps++;
-          temp=header_name_list[i];
-          header_name_list[i]=header_name_list[j];
-          header_name_list[j]=temp;
-          if(gbl_frag){
-            temp=group_name_list[i];
-            group_name_list[i]=group_name_list[j];
-            group_name_list[j]=temp;
-          }
-          itemp=order[i];
-          order[i]=order[j];
-          order[j]=itemp;
-        }
+   while((header = next_header(fin,&offset))){
+      records++;
+      b_num_chars = key_scan(header, &h);
+      matched = selset_find(header, b_num_chars, h);
+      if(matched != -1){
+         counts[matched]++;
+         hits++;
       }
-      if(gap==1){
-        if(swaps==0){
-          done=1;
-          break;
-        }
-        else {
-          restart++;
-          if(restart > 7)break;
-        }
+   }
+   for(i=0;i<entrynum;i++){
+      if(counts[i])found++;
+      if(counts[i]>1)multiple++;
+   }
+   emitted = (gbl_reject ? records - hits : hits);
+
+   if(gbl_check){
+      int *listed=malloc(entrynum*sizeof(int));
+      if(!listed)insane("fastaselecth: fatal error: could not allocate memory");
+      for(i=0;i<entrynum;i++){ listed[emitorder[i]]=i; }
+      for(i=0;i<entrynum;i++){
+         (void) fprintf(stdout,"%s\t%u\n",header_name_list[listed[i]],counts[listed[i]]);
       }
-    }
-  }
+      free(listed);
+   }
+   if(gbl_count){
+      (void) fprintf(stdout,"selectors\t%d\n",entrynum);
+      (void) fprintf(stdout,"found\t%d\n",found);
+      (void) fprintf(stdout,"missing\t%d\n",entrynum - found);
+      (void) fprintf(stdout,"records\t%llu\n",records);
+      (void) fprintf(stdout,"matched\t%llu\n",hits);
+      (void) fprintf(stdout,"emitted\t%llu\n",emitted);
+   }
+   if(gbl_missout){
+      unsigned char *foundbits=calloc(BITSET_BYTES(entrynum),1);
+      if(!foundbits)insane("fastaselecth: fatal error: could not allocate memory");
+      for(i=0;i<entrynum;i++){
+         if(counts[i])BIT_SET(foundbits,i);
+      }
+      (void) write_selectors(gbl_missout, header_name_list, emitorder, foundbits, 0, entrynum);
+      free(foundbits);
+   }
+   if(multiple && !gbl_reject){
+      (void) fprintf(stderr,"fastaselecth: warning: %d selectors match more than one record\n",multiple);
+   }
+   fprintf(stderr,"fastaselecth: status: selectors: %d, records read: %llu, emitted: %llu\n",entrynum, records,emitted);
+   free(counts);
+   close_in(fin);
+   if(found < entrynum && !gbl_com){
+      (void) fprintf(stderr,"fastaselecth: fatal error: %d selectors were not found\n",entrynum - found);
+      exit(EXIT_FAILURE);
+   }
+   exit(EXIT_SUCCESS);
 }
 
-void remove_dups(char **header_name_list, char **group_name_list, int *emit_order, int *entrynum){
-int i;
-   if(*entrynum==1)return;
-   char *dst=header_name_list[0];
-   int   didx=0;
-   for(i=1;i<*entrynum;i++){
-       if(strcmp(dst,header_name_list[i]) == 0){
-          if(gbl_cod){
-             fprintf(stderr,"fastaselecth: warning: duplicate entry name \"%s\" in -sel list, alternate header terminators may be needed\n",dst);
-          }
-          else {
-             insane("fastaselecth: fatal error: duplicate entry names in list, alternate header terminators may be needed");
-          }
-          free(header_name_list[i]);
-       }
-       else {
-          didx++;
-          if(didx != i){
-             header_name_list[didx] = header_name_list[i];
-             if(gbl_frag){
-                group_name_list[didx]  = group_name_list[i];
-             }
-             emit_order[didx]       = emit_order[i];
-          }
-          dst = header_name_list[didx];
-       }
+/* Build the header line for an emitted record in buffer, with -prefix, -strip-desc,
+   and newname, if not NULL, in place of the klen characters of the name.
+   header is the input line without its >.
+*/
+void rewrite_header(char *buffer, char *header, size_t klen, char *newname){
+   char *bp = buffer;
+   *bp++ = '>';
+   if(gbl_prefix){
+      strcpy(bp, gbl_prefix);
+      bp += strlen(gbl_prefix);
+   }
+   if(newname){
+      strcpy(bp, newname);
+      bp += strlen(newname);
+   }
+   else {
+      memcpy(bp, header, klen);
+      bp += klen;
+   }
+   if(gbl_stripdesc){
+      *bp = '\0';
+   }
+   else {
+      strcpy(bp, header + klen);
    }
-   *entrynum=didx+1;
 }
 
 /* return position found or -1 if not found. */
@@ -561,15 +3678,67 @@ int ok     = 1;
    return(status);
 }
 
+/* Build the -out-format line for one record.
+
+   header      the header line without the leading >
+   hoffset     byte offset of the header line in -in
+   soffset     byte offset of the first sequence line in -in
+   length      number of sequence characters, line ends excluded
+   linebases   characters in the first sequence line
+   linewidth   bytes in the first sequence line, line end included
+
+   Returns a malloc'd string ending in \n.
+*/
+char *format_meta(char *header, unsigned long long hoffset, unsigned long long soffset,
+   unsigned long long length, int linebases, int linewidth){
+   size_t klen = strcspn(header,gbl_hi);
+   char  *desc = header + klen;
+   desc += strspn(desc,gbl_hi);
+   char  *meta = malloc(klen + strlen(desc) + 100);
+   if(!meta)insane("fastaselecth: fatal error: could not allocate memory");
+   switch(gbl_outfmt){
+      case OUTFMT_TSV:
+         (void) sprintf(meta,"%.*s\t%llu\t%llu\t%s\n",(int) klen,header,length,hoffset,desc);
+         break;
+      case OUTFMT_IDS:
+         (void) sprintf(meta,"%.*s\n",(int) klen,header);
+         break;
+      case OUTFMT_FAI:
+         (void) sprintf(meta,"%.*s\t%llu\t%llu\t%d\t%d\n",(int) klen,header,length,soffset,linebases,linewidth);
+         break;
+      case OUTFMT_BED:
+         (void) sprintf(meta,"%.*s\t0\t%llu\n",(int) klen,header,length);
+         break;
+      default:
+         insane("fastaselecth: fatal programming error: unknown output format");
+   }
+   return(meta);
+}
+
 void emit_help(void){
    (void) fprintf(stderr,"Usage: fastaselecth [options]\n");
    (void) fprintf(stderr,"       select a subset of records in a fastafile by header values.\n\n");
    (void) fprintf(stderr,"Command line options:\n");
    (void) fprintf(stderr,"   -in FILE\n");
-   (void) fprintf(stderr,"         Read fasta records from FILE.\n");
+   (void) fprintf(stderr,"         Read fasta records from FILE.  FILE may also be a UCSC .2bit file, recognized by\n");
+   (void) fprintf(stderr,"         its signature.  Its records are then found through the index and decoded as they\n");
+   (void) fprintf(stderr,"         are written, %d bases per line, with N blocks and lowercase soft masking.  Not with\n",TWOBIT_LINE);
+   (void) fprintf(stderr,"         -validate, -stats-all, -replace-with, -count, -check or -out-format fai.\n");
+   (void) fprintf(stderr,"         A gzip compressed FILE is also recognized and read through the first of rapidgzip\n");
+   (void) fprintf(stderr,"         (parallel), pigz or gzip found on the PATH.  Install rapidgzip for large files, the\n");
+   (void) fprintf(stderr,"         others decompress on one core and a warning is given when they are used.\n");
    (void) fprintf(stderr,"   -out FILE\n");
    (void) fprintf(stderr,"         Selected records go to FILE.  If omitted or FILE is \"-\" write to stdout instead..\n");
    (void) fprintf(stderr,"         If -frag[ca] is set FILE must be like \"template_%%s.fasta\"\n");
+   (void) fprintf(stderr,"   -out-format FORMAT\n");
+   (void) fprintf(stderr,"         Emit one line per selected record instead of the record itself.  Sequence lines\n");
+   (void) fprintf(stderr,"         are only counted.  FORMAT is one of:\n");
+   (void) fprintf(stderr,"            fasta  the records (default);\n");
+   (void) fprintf(stderr,"            tsv    name, length, header byte offset, description;\n");
+   (void) fprintf(stderr,"            ids    name;\n");
+   (void) fprintf(stderr,"            fai    name, length, sequence byte offset, bases per line, bytes per line\n");
+   (void) fprintf(stderr,"                   (samtools faidx layout);\n");
+   (void) fprintf(stderr,"            bed    name, 0, length.\n");
    (void) fprintf(stderr,"   -sel FILE\n");
    (void) fprintf(stderr,"         Name of a file containing record selection information.  Default or \"-\" is stdin.\n");
    (void) fprintf(stderr,"         If -frag[ca] is set every select string must have two fields: select and group.\n");
@@ -587,16 +3756,122 @@ void emit_help(void){
    (void) fprintf(stderr,"         -reject is also specified.  Such a selector may not trigger an error\n");
    (void) fprintf(stderr,"         without -reject if all other selectors have already matched, as the program\n");
    (void) fprintf(stderr,"         will exit normally at the first match and so never encounter the duplicates.\n");
+   (void) fprintf(stderr,"   -count\n");
+   (void) fprintf(stderr,"         Read only the header lines of -in and report to stdout the number of selectors,\n");
+   (void) fprintf(stderr,"         how many were found and missing, records read, records matched and the number\n");
+   (void) fprintf(stderr,"         of records which would have been emitted.  Nothing is written to -out.\n");
+   (void) fprintf(stderr,"   -check\n");
+   (void) fprintf(stderr,"         Like -count, but report each selector, in -sel order, with the number of\n");
+   (void) fprintf(stderr,"         records it matched, 0 if it is missing.  May be combined with -count.\n");
+   (void) fprintf(stderr,"         With either option missing selectors are a fatal error unless -com is set.\n");
+   (void) fprintf(stderr,"   -missing-out FILE\n");
+   (void) fprintf(stderr,"         Write the selectors which matched no record to FILE, one per line in -sel order,\n");
+   (void) fprintf(stderr,"         instead of a warning per selector.  Also with -reject, -count, and -check.\n");
+   (void) fprintf(stderr,"   -dup-out FILE\n");
+   (void) fprintf(stderr,"         Write the selectors which occur more than once in -sel to FILE, one per line\n");
+   (void) fprintf(stderr,"         in -sel order.  The list is complete even when -cod is not set and duplicates\n");
+   (void) fprintf(stderr,"         remain fatal.\n");
+   (void) fprintf(stderr,"   -validate\n");
+   (void) fprintf(stderr,"         Check every line of -in while selecting: sequence characters against -alpha,\n");
+   (void) fprintf(stderr,"         records without sequence, \\r line ends, headers without a name, sequence\n");
+   (void) fprintf(stderr,"         before the first header, and names shared by more than one header anywhere in -in.\n");
+   (void) fprintf(stderr,"         The first %d of each are reported, then a summary.  Any problem makes the exit\n",VALIDATE_SHOW);
+   (void) fprintf(stderr,"         status a failure.  The whole of -in is read even when all selections are done.\n");
+   (void) fprintf(stderr,"   -alpha ALPHABET\n");
+   (void) fprintf(stderr,"         Sequence alphabet for -validate, case is ignored:\n");
+   (void) fprintf(stderr,"            protein  letters A-Z, * and - (default);\n");
+   (void) fprintf(stderr,"            dna      IUPAC nucleotide codes ACGTURYSWKMBDHVN and -.\n");
+   (void) fprintf(stderr,"   -audit-dups\n");
+   (void) fprintf(stderr,"         Check that every header name in -in is unique.  Only header lines are read and\n");
+   (void) fprintf(stderr,"         only a hash and an offset are kept per name.  Each repeat is written to -out as\n");
+   (void) fprintf(stderr,"         name, byte offset of the first header, byte offset of the repeat.  Any repeat\n");
+   (void) fprintf(stderr,"         makes the exit status a failure.  -sel is not used.\n");
+   (void) fprintf(stderr,"   -diff A B\n");
+   (void) fprintf(stderr,"         Compare the fasta files A and B by name, in place of -in and -sel.  Writes to -out\n");
+   (void) fprintf(stderr,"         \"<\\tname\" for names only in A, \">\\tname\" for names only in B, and \"!\\tname\"\n");
+   (void) fprintf(stderr,"         for names in both whose sequences differ, ignoring line width and \\r.  Only a\n");
+   (void) fprintf(stderr,"         name and a 64 bit hash are kept per record of A, B is streamed.  Names must be\n");
+   (void) fprintf(stderr,"         unique within each file, see -audit-dups.  As with diff, the exit status is 0 when\n");
+   (void) fprintf(stderr,"         nothing was written and 1 when any line was, or on an error.\n");
+   (void) fprintf(stderr,"   -stats-seq FILE\n");
+   (void) fprintf(stderr,"         Write statistics for the emitted records to FILE: record and residue counts,\n");
+   (void) fprintf(stderr,"         minimum, maximum and mean length, N50/L50, N90/L90, GC fraction, a log2 length\n");
+   (void) fprintf(stderr,"         histogram and residue composition.  Collected during the scan, no second pass.\n");
+   (void) fprintf(stderr,"   -stats-all\n");
+   (void) fprintf(stderr,"         Also write the same statistics for every record in -in.  Reads all of -in.\n");
+   (void) fprintf(stderr,"   -rename FILE\n");
+   (void) fprintf(stderr,"         Each line of FILE holds an old and a new name, separated as for -hs.  Emitted\n");
+   (void) fprintf(stderr,"         records whose name is an old name are written with the new name instead.\n");
+   (void) fprintf(stderr,"   -prefix STRING\n");
+   (void) fprintf(stderr,"         Insert STRING before the name of every emitted record.\n");
+   (void) fprintf(stderr,"   -strip-desc\n");
+   (void) fprintf(stderr,"         Drop everything after the name in the header lines of emitted records.\n");
+   (void) fprintf(stderr,"         -rename, -prefix and -strip-desc also apply to the names in -out-format.\n");
+   (void) fprintf(stderr,"   -replace-with FILE\n");
+   (void) fprintf(stderr,"         Copy all of -in to -out, except that each record whose name matches a record\n");
+   (void) fprintf(stderr,"         in the fasta FILE is written from FILE instead.  FILE is held in memory, -in\n");
+   (void) fprintf(stderr,"         is streamed once.  Replaces -sel.  Records in FILE which match nothing in -in\n");
+   (void) fprintf(stderr,"         are treated like missing selectors, see -com and -missing-out.\n");
+   (void) fprintf(stderr,"   -manifest FILE\n");
+   (void) fprintf(stderr,"         Write one line per emitted record to FILE: name, output file (\"-\" for stdout),\n");
+   (void) fprintf(stderr,"         byte offset in that file, length in bytes and the XXH64 hash of those bytes in\n");
+   (void) fprintf(stderr,"         hex.  Computed as the records are written.  Not with -out-format.\n");
+   (void) fprintf(stderr,"   -verify FILE\n");
+   (void) fprintf(stderr,"         Reread every record listed in the -manifest FILE from its output file and check\n");
+   (void) fprintf(stderr,"         the length and hash.  Problems go to -out as name, file and \"file missing\",\n");
+   (void) fprintf(stderr,"         \"truncated\" or \"changed\", and make the exit status a failure.  No -in or -sel.\n");
+   (void) fprintf(stderr,"   -fingerprint MODE\n");
+   (void) fprintf(stderr,"         Write \"MODE<tab>hash<tab>-in\" to stdout and exit.  The hash changes when -in does:\n");
+   (void) fprintf(stderr,"            sampled  size, modification time, inode and %d blocks of %d bytes from\n",FPRINT_NSAMPLE,FPRINT_BLOCK);
+   (void) fprintf(stderr,"                     across the file.  Fast on any size of file;\n");
+   (void) fprintf(stderr,"            full     size and every byte, read by up to %d threads.  Only depends on\n",FPRINT_THREADS);
+   (void) fprintf(stderr,"                     the content, so copies of a file have the same hash.\n");
+   (void) fprintf(stderr,"   -shm-index DIR\n");
+   (void) fprintf(stderr,"         Keep the header index of -in, names and record offsets, as a file in DIR, where\n");
+   (void) fprintf(stderr,"         DIR is normally /dev/shm or a hugetlbfs mount.  The first run scans the headers\n");
+   (void) fprintf(stderr,"         and publishes it, later runs on the same -in map it read only, so that concurrent\n");
+   (void) fprintf(stderr,"         runs share one copy in memory, and seek straight to each selected record.  Files\n");
+   (void) fprintf(stderr,"         are named from -fingerprint sampled and -hi, a changed -in gets a new one.  Only\n");
+   (void) fprintf(stderr,"         used for selections without -reject, -rename, -prefix, -strip-desc, -out-format,\n");
+   (void) fprintf(stderr,"         -stats-seq, -validate, -count or -check, from an uncompressed -in.\n");
+   (void) fprintf(stderr,"   -skip M\n");
+   (void) fprintf(stderr,"   -head N\n");
+   (void) fprintf(stderr,"         Emit only records M+1 to M+N, counted in output order.  -in is read no further\n");
+   (void) fprintf(stderr,"         than needed for them, and with a .2bit -in or -shm-index the skipped records are\n");
+   (void) fprintf(stderr,"         not read at all.  Default M is 0 and N is unlimited.  Use -head to check the\n");
+   (void) fprintf(stderr,"         delimiter settings on a few records before a long run.  Not with -replace-with,\n");
+   (void) fprintf(stderr,"         -count, -check, -validate or -stats-seq, nor -head with -missing-out.\n");
+   (void) fprintf(stderr,"   -build-cache FILE\n");
+   (void) fprintf(stderr,"         Write the DNA fasta -in to FILE in UCSC .2bit form: 2 bits per base, plus runs of N\n");
+   (void) fprintf(stderr,"         and of lowercase, and an index of the names.  Use FILE as -in for later selections,\n");
+   (void) fprintf(stderr,"         they read about a quarter of the bytes and seek straight to each record.  Only the\n");
+   (void) fprintf(stderr,"         names are kept from the headers, and lines are rewritten %d bases long.  Any\n",TWOBIT_LINE);
+   (void) fprintf(stderr,"         character other than ACGTN, in either case, is fatal.  -sel is not used.  FILE is\n");
+   (void) fprintf(stderr,"         written as FILE.partial and renamed when complete, a stopped run leaves no FILE.\n");
    (void) fprintf(stderr,"   -fragc\n");
    (void) fprintf(stderr,"         Direct selections to multiple output files, none of which may exist.  Each group must be in\n");
    (void) fprintf(stderr,"         a contiguous series of select entries or a fatal error occurs.\n");
    (void) fprintf(stderr,"   -fraga\n");
    (void) fprintf(stderr,"         Direct selections to multiple output files, which may exist, and entries will be appended\n");
    (void) fprintf(stderr,"         to them.  Groups need not be clustered in the selection input.\n");
+   (void) fprintf(stderr,"   -fragg\n");
+   (void) fprintf(stderr,"         As -fragc, but groups need not be clustered in the selection input.  Records are\n");
+   (void) fprintf(stderr,"         written a group at a time, groups in order of their first entry, so each file is\n");
+   (void) fprintf(stderr,"         opened once.  Records found before their group's turn are held in memory.\n");
+   (void) fprintf(stderr,"   -out-tar FILE\n");
+   (void) fprintf(stderr,"         With -fragc or -fragg, write the group files as entries of the tar archive FILE,\n");
+   (void) fprintf(stderr,"         named from -out as the files would be, instead of creating them.  FILE ending in\n");
+   (void) fprintf(stderr,"         .zst is compressed by zstd, which must be installed.  For one file per record give\n");
+   (void) fprintf(stderr,"         each selector itself as its group, as in: paste ids ids | fastaselecth -fragc ...\n");
    (void) fprintf(stderr,"   -reject\n");
-   (void) fprintf(stderr,"         Reject selected entries.  Default is to accept selected entries.  Not with -frag[ac]\n");
+   (void) fprintf(stderr,"         Reject selected entries.  Default is to accept selected entries.  Not with -frag[acg]\n");
+   (void) fprintf(stderr,"         With -reject -sel may be empty, then every record is emitted, for instance\n");
+   (void) fprintf(stderr,"         -reject -sel /dev/null -out-format tsv lists all of -in.\n");
    (void) fprintf(stderr,"   -wl N\n");
    (void) fprintf(stderr,"         Width of Longest input line.  Default is %d.\n",MYMAXSTRING);
+   (void) fprintf(stderr,"         Plain selections and rejections, without -out-format, -stats-seq, -validate,\n");
+   (void) fprintf(stderr,"         -replace-with, -rename, -prefix or -strip-desc, read -in in blocks, then only\n");
+   (void) fprintf(stderr,"         header lines are limited by it.\n");
    (void) fprintf(stderr,"   -hs STRING\n");
    (void) fprintf(stderr,"   -ht STRING\n");
    (void) fprintf(stderr,"         Specify an alternate set of -sel FILE delimiters.  The first delimiter\n");
@@ -612,6 +3887,8 @@ void emit_help(void){
    (void) fprintf(stderr,"   -hhead\n");
    (void) fprintf(stderr,"         Print explanation of header selection and header delimiters.\n");
    (void) fprintf(stderr,"   -i    Emit version, copyright, license and contact information\n\n");
+   (void) fprintf(stderr,"SIGINT or SIGTERM stop a run at the next record.  Its output files are removed, -fraga files\n");
+   (void) fprintf(stderr,"are cut back to their size before the run, and the exit status is 128 plus the signal number.\n\n");
 }
 
 void emit_hhead(void){
@@ -622,7 +3899,7 @@ void emit_hhead(void){
    (void) fprintf(stderr,"The delimiter set applied is determined by the -hi parameter.\n");
    (void) fprintf(stderr,"\n");
    (void) fprintf(stderr,"Select files contain a series of entry names, one per line, terminated by a delimiter.\n");
-   (void) fprintf(stderr,"If -fragc or -fraga is used the entry is followed by a group name which is .\n");
+   (void) fprintf(stderr,"If -fragc, -fraga or -fragg is used the entry is followed by a group name which is\n");
    (void) fprintf(stderr,"  used to construct the output file name.\n");
    (void) fprintf(stderr,"The delimiter set applied is determined by the -ht parameter.\n");
    (void) fprintf(stderr,"Entry names correspond to the \">NAME\" part of a fasta header line.\n");
@@ -665,6 +3942,30 @@ void process_command_line_args(int argc,char **argv){
    gbl_cod = 0;
    gbl_wl  = MYMAXSTRING;
    gbl_reject = 0;
+   gbl_outfmt = OUTFMT_FASTA;
+   gbl_count  = 0;
+   gbl_check  = 0;
+   gbl_missout= NULL;
+   gbl_dupout = NULL;
+   gbl_validate = 0;
+   gbl_alpha  = ALPHA_PROTEIN;
+   gbl_audit  = 0;
+   gbl_statsout = NULL;
+   gbl_statsall = 0;
+   gbl_rename = NULL;
+   gbl_prefix = NULL;
+   gbl_stripdesc = 0;
+   gbl_replace = NULL;
+   gbl_diffa = NULL;
+   gbl_diffb = NULL;
+   gbl_cache = NULL;
+   gbl_manifest = NULL;
+   gbl_outtar = NULL;
+   gbl_verify = NULL;
+   gbl_fprint = 0;
+   gbl_shmdir = NULL;
+   gbl_skip = 0;
+   gbl_head = 0;
 
    while( ++numarg < argc){
       if( (lcl_strcasecmp(argv[numarg], "-h")==0)     ||
@@ -693,6 +3994,18 @@ void process_command_line_args(int argc,char **argv){
       else if(lcl_strcasecmp(argv[numarg], "-out")==0){
          gbl_out = argv[++numarg];
       }
+      else if(lcl_strcasecmp(argv[numarg], "-out-format")==0){
+         char *fmt = argv[++numarg];
+         if(!fmt)insane("fastaselecth: fatal error: -out-format: missing argument");
+         if(     lcl_strcasecmp(fmt, "fasta")==0){ gbl_outfmt = OUTFMT_FASTA; }
+         else if(lcl_strcasecmp(fmt, "tsv")==0){   gbl_outfmt = OUTFMT_TSV;   }
+         else if(lcl_strcasecmp(fmt, "ids")==0){   gbl_outfmt = OUTFMT_IDS;   }
+         else if(lcl_strcasecmp(fmt, "fai")==0){   gbl_outfmt = OUTFMT_FAI;   }
+         else if(lcl_strcasecmp(fmt, "bed")==0){   gbl_outfmt = OUTFMT_BED;   }
+         else {
+            insane("fastaselecth: fatal error: -out-format must be one of fasta, tsv, ids, fai, bed");
+         }
+      }
       else if(lcl_strcasecmp(argv[numarg], "-sel")==0){
          gbl_sel = argv[++numarg];
       }
@@ -702,6 +4015,9 @@ void process_command_line_args(int argc,char **argv){
       else if(lcl_strcasecmp(argv[numarg], "-fraga")==0){
          gbl_frag = FRAG_APPEND;
       }
+      else if(lcl_strcasecmp(argv[numarg], "-fragg")==0){
+         gbl_frag = FRAG_GROUP;
+      }
       else if(lcl_strcasecmp(argv[numarg], "-reject")==0){
          gbl_reject = 1;
       }
@@ -730,6 +4046,97 @@ void process_command_line_args(int argc,char **argv){
       else if(lcl_strcasecmp(argv[numarg], "-cod")==0){
          gbl_cod=1;
       }
+      else if(lcl_strcasecmp(argv[numarg], "-missing-out")==0){
+         gbl_missout = argv[++numarg];
+         if(!gbl_missout)insane("fastaselecth: fatal error: -missing-out: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-dup-out")==0){
+         gbl_dupout = argv[++numarg];
+         if(!gbl_dupout)insane("fastaselecth: fatal error: -dup-out: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-validate")==0){
+         gbl_validate=1;
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-alpha")==0){
+         char *alpha = argv[++numarg];
+         if(!alpha)insane("fastaselecth: fatal error: -alpha: missing argument");
+         if(     lcl_strcasecmp(alpha, "protein")==0){ gbl_alpha = ALPHA_PROTEIN; }
+         else if(lcl_strcasecmp(alpha, "dna")==0){     gbl_alpha = ALPHA_DNA;     }
+         else {
+            insane("fastaselecth: fatal error: -alpha must be protein or dna");
+         }
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-audit-dups")==0){
+         gbl_audit=1;
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-diff")==0){
+         if(numarg + 2 >= argc)insane("fastaselecth: fatal error: -diff: needs two file names");
+         gbl_diffa = argv[++numarg];
+         gbl_diffb = argv[++numarg];
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-stats-seq")==0){
+         gbl_statsout = argv[++numarg];
+         if(!gbl_statsout)insane("fastaselecth: fatal error: -stats-seq: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-stats-all")==0){
+         gbl_statsall=1;
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-rename")==0){
+         gbl_rename = argv[++numarg];
+         if(!gbl_rename)insane("fastaselecth: fatal error: -rename: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-prefix")==0){
+         gbl_prefix = argv[++numarg];
+         if(!gbl_prefix)insane("fastaselecth: fatal error: -prefix: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-strip-desc")==0){
+         gbl_stripdesc=1;
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-fingerprint")==0){
+         char *mode = argv[++numarg];
+         if(!mode)insane("fastaselecth: fatal error: -fingerprint: missing argument");
+         if(     lcl_strcasecmp(mode, "sampled")==0){ gbl_fprint = FPRINT_SAMPLED; }
+         else if(lcl_strcasecmp(mode, "full")==0){    gbl_fprint = FPRINT_FULL;    }
+         else {
+            insane("fastaselecth: fatal error: -fingerprint must be sampled or full");
+         }
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-shm-index")==0){
+         gbl_shmdir = argv[++numarg];
+         if(!gbl_shmdir)insane("fastaselecth: fatal error: -shm-index: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-skip")==0){
+         setirangenumeric(&gbl_skip,&numarg,0,INT_MAX,argc,argv,"-skip");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-head")==0){
+         setirangenumeric(&gbl_head,&numarg,1,INT_MAX,argc,argv,"-head");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-manifest")==0){
+         gbl_manifest = argv[++numarg];
+         if(!gbl_manifest)insane("fastaselecth: fatal error: -manifest: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-out-tar")==0){
+         gbl_outtar = argv[++numarg];
+         if(!gbl_outtar)insane("fastaselecth: fatal error: -out-tar: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-verify")==0){
+         gbl_verify = argv[++numarg];
+         if(!gbl_verify)insane("fastaselecth: fatal error: -verify: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-build-cache")==0){
+         gbl_cache = argv[++numarg];
+         if(!gbl_cache)insane("fastaselecth: fatal error: -build-cache: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-replace-with")==0){
+         gbl_replace = argv[++numarg];
+         if(!gbl_replace)insane("fastaselecth: fatal error: -replace-with: missing argument");
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-count")==0){
+         gbl_count=1;
+      }
+      else if(lcl_strcasecmp(argv[numarg], "-check")==0){
+         gbl_check=1;
+      }
       else {
          (void) fprintf(stderr,"Unknown command line argument: %s\n",argv[numarg]);
          emit_help();
@@ -738,31 +4145,94 @@ void process_command_line_args(int argc,char **argv){
    }
 
    /* sanity checking */
+   if(gbl_verify){
+      if(gbl_in || gbl_sel || gbl_diffa || gbl_manifest)insane("fastaselecth: fatal error: -verify cannot be combined with -in, -sel, -diff or -manifest");
+      return;
+   }
+   if(gbl_diffa){
+      if(gbl_in || gbl_sel || gbl_replace || gbl_audit)insane("fastaselecth: fatal error: -diff cannot be combined with -in, -sel, -replace-with or -audit-dups");
+      return;
+   }
    if(!gbl_in)insane("fastaselecth: fatal error: no -in specified");
-   if(!gbl_sel )insane("fastaselecth: fatal error: -sel must be specified");
-   if(gbl_frag && !strstr(gbl_out,"%s"))insane("fastaselecth: fatal error: -frag set but -out does not contain %s");
+   if(gbl_fprint){
+      if(gbl_sel || gbl_audit || gbl_cache || gbl_replace)insane("fastaselecth: fatal error: -fingerprint cannot be combined with -sel, -audit-dups, -build-cache or -replace-with");
+      return;
+   }
+   if(gbl_replace){
+      if(gbl_sel)insane("fastaselecth: fatal error: -replace-with cannot be combined with -sel");
+      if(gbl_reject || gbl_frag || gbl_count || gbl_check || gbl_outfmt || gbl_statsout || gbl_rename || gbl_prefix || gbl_stripdesc){
+         insane("fastaselecth: fatal error: -replace-with cannot be combined with -reject, -frag[ac], -count, -check, -out-format, -stats-seq, -rename, -prefix or -strip-desc");
+      }
+      gbl_reject = 1;  /* copy everything not replaced */
+   }
+   else if(gbl_cache){
+      if(gbl_sel || gbl_audit)insane("fastaselecth: fatal error: -build-cache cannot be combined with -sel or -audit-dups");
+   }
+   else if(!gbl_sel && !gbl_audit)insane("fastaselecth: fatal error: -sel must be specified");
+   if(gbl_frag && !(gbl_count || gbl_check) && !strstr(gbl_out,"%s"))insane("fastaselecth: fatal error: -frag set but -out does not contain %s");
+   if(gbl_manifest && (gbl_outfmt || gbl_count || gbl_check || gbl_audit || gbl_cache)){
+      insane("fastaselecth: fatal error: -manifest needs fasta output, not -out-format, -count, -check, -audit-dups or -build-cache");
+   }
+   if(gbl_statsall && !gbl_statsout)insane("fastaselecth: fatal error: -stats-all requires -stats-seq");
+   if(gbl_statsout && (gbl_count || gbl_check))insane("fastaselecth: fatal error: -stats-seq cannot be combined with -count or -check");
+   if(gbl_rename && gbl_sel && !strcmp(gbl_rename,"-") && !strcmp(gbl_sel,"-"))insane("fastaselecth: fatal error: -sel and -rename cannot both be stdin");
+   if(gbl_validate && (gbl_count || gbl_check))insane("fastaselecth: fatal error: -validate cannot be combined with -count or -check");
    if(gbl_frag && gbl_reject)insane("fastaselecth: fatal error: -frag cannot be combined with -reject");
+   if(gbl_outtar && (gbl_frag == FRAG_NONE || gbl_frag == FRAG_APPEND))insane("fastaselecth: fatal error: -out-tar needs -fragc or -fragg");
+   if(gbl_outtar && (gbl_manifest || gbl_count || gbl_check)){
+      insane("fastaselecth: fatal error: -out-tar cannot be combined with -manifest, -count or -check");
+   }
+   if((gbl_skip || gbl_head) && (gbl_replace || gbl_count || gbl_check || gbl_validate || gbl_statsout)){
+      insane("fastaselecth: fatal error: -skip and -head cannot be combined with -replace-with, -count, -check, -validate or -stats-seq");
+   }
+   if(gbl_head && gbl_missout)insane("fastaselecth: fatal error: -head cannot be combined with -missing-out");
 }
 
 int main(int argc, char *argv[]){
    char *newline=NULL;
    char *tbuf=NULL;
    char **header_name_list=NULL;
-   char **group_name_list=NULL;
-   int  *emitlist=NULL;
+   int  *group_list=NULL;               /* -frag group of each selector, see group_intern() */
+   unsigned char *emitlist=NULL;       /* bitset, selector has matched a record */
+   unsigned char *duplist=NULL;        /* bitset, selector was repeated in -sel */
+   int  missing;
    int  emitting;
    int  *emitorder=NULL;
+   int  *selorder=NULL;                /* -sel line of each selector, emitorder but for -fragg */
    char **emitstrings=NULL;
-   char **emitgroups=NULL;
+   int  *emitgroups=NULL;
    char *accumstring=NULL;
    int  entrynum,emit;
    int  DONE;
-   int  i,tail,size;
+   int  i;
+   size_t tail,size;                   /* accumstring: used, allocated */
    int  lastemitted;
    char *bptr=NULL;
-   char *last_group;
-   char empty_string[]="";
-   char temp_name[1028];
+   int  last_group=-1;
+   size_t linelen;                     /* characters in bigstring, line end removed */
+   size_t rawlen;                      /* bytes in the input line, line end included */
+   int  had_cr;                        /* the line ended in \r\n */
+   unsigned long long fileoffset=0;    /* offset in -in of the line in bigstring */
+   char *meta_header=NULL;             /* -out-format state for the current emitted record */
+   unsigned long long meta_hoffset=0;
+   unsigned long long meta_soffset=0;
+   unsigned long long meta_length=0;
+   int  meta_linebases=0;
+   int  meta_linewidth=0;
+   char **rename_old=NULL;             /* -rename table, sorted by old name */
+   char **rename_new=NULL;
+   int    rename_num=0;
+   char **new_name_list=NULL;          /* -rename, new name for each selector or NULL */
+   char  *outheader=NULL;              /* rewritten header line */
+   char  *outline;                     /* bigstring or outheader, the line to emit */
+   char **update_text=NULL;            /* -replace-with record for each selector, in -sel order */
+   size_t *update_len=NULL;
+   char  *update_buf=NULL;
+   unsigned long long replaced=0;
+   SEQSTATS *sel_stats=NULL;           /* -stats-seq, emitted records */
+   SEQSTATS *all_stats=NULL;           /* -stats-all, every record */
+   TWOBIT *tb=NULL;                    /* -in is a .2bit file */
+   SHMIDX *ix=NULL;                    /* -shm-index of -in */
    
    unsigned long long records;
    unsigned long long emitted;
@@ -777,27 +4247,111 @@ int main(int argc, char *argv[]){
    DONE        = 0;
    lastemitted = -1;
 
+   if(gbl_verify){
+      verify_manifest(gbl_verify, bigstring);
+   }
+   if(gbl_fprint){
+      (void) fprintf(stdout,"%s\t%016llx\t%s\n", (gbl_fprint == FPRINT_FULL ? "full" : "sampled"),
+         (unsigned long long) fingerprint(gbl_in, gbl_fprint), gbl_in);
+      exit(EXIT_SUCCESS);
+   }
+   if(gbl_diffa){
+      diff_files(gbl_diffa, gbl_diffb, bigstring);
+   }
+   if(gbl_audit){
+      FILE *fin = open_in(gbl_in);
+      if(!fin)insane("fastaselecth: fatal error: could not open -in");
+      if(twobit_open(fin))insane("fastaselecth: fatal error: -audit-dups cannot read a .2bit -in");
+      audit_dups(fin);
+   }
+   if(gbl_cache){
+      FILE *fin = open_in(gbl_in);
+      if(!fin)insane("fastaselecth: fatal error: could not open -in");
+      if(twobit_open(fin))insane("fastaselecth: fatal error: -build-cache: -in is already a .2bit file");
+      if(fseeko(fin, 0, SEEK_SET))insane("fastaselecth: fatal error: -build-cache reads -in twice, it must be a regular file");
+      build_cache(fin, gbl_cache);
+   }
+
    
-   entrynum    = get_entries(bigstring, &header_name_list, &group_name_list);
-   if(!entrynum)insane("fastaselecth: fatal error: nothing was read from -sel");
+   if(gbl_replace){
+      entrynum = get_updates(gbl_replace, &header_name_list, &update_text, &update_len, &update_buf);
+      if(!entrynum)insane("fastaselecth: fatal error: nothing was read from -replace-with");
+   }
+   else {
+      entrynum = get_entries(gbl_sel, 0, bigstring, &header_name_list, NULL, (gbl_frag ? &group_list : NULL));
+      if(!entrynum && !gbl_reject)insane("fastaselecth: fatal error: nothing was read from -sel");
+   }
 
-   emitlist    = calloc(entrynum,sizeof(int));
+   /* +1: with -reject the list may be empty */
+   emitlist    = calloc(BITSET_BYTES(entrynum + 1),1);
    if(emitlist==NULL)insane("fastaselecth: fatal error: could not allocate memory");
 
-   emitorder   =calloc(entrynum,sizeof(int));
+   duplist     = calloc(BITSET_BYTES(entrynum + 1),1);
+   if(duplist==NULL)insane("fastaselecth: fatal error: could not allocate memory");
+
+   emitorder   =calloc(entrynum + 1,sizeof(int));
    if(emitorder==NULL)insane("fastaselecth: fatal error: could not allocate memory");
 
-   emitstrings =calloc(entrynum,sizeof(char *));
+   emitstrings =calloc(entrynum + 1,sizeof(char *));
    if(emitstrings==NULL)insane("fastaselecth: fatal error: could not allocate memory");
 
    if(gbl_frag){
-     emitgroups =calloc(entrynum,sizeof(char *));
+     emitgroups =calloc(entrynum + 1,sizeof(int));
      if(emitgroups==NULL)insane("fastaselecth: fatal error: could not allocate memory");
    }
 
    for(i=0;i<entrynum;i++){emitorder[i]=i;}
-   sort_entries(header_name_list, group_name_list, emitorder, entrynum);
-   remove_dups(header_name_list, group_name_list, emitorder, &entrynum);
+   sort_entries(header_name_list, NULL, emitorder, entrynum);
+   if(gbl_frag){
+      /* put the groups in the sorted order, emitorder still holds each selector's -sel line */
+      int *sorted = malloc((entrynum + 1)*sizeof(int));
+      if(!sorted)insane("fastaselecth: fatal error: could not allocate memory");
+      for(i=0;i<entrynum;i++){ sorted[i] = group_list[emitorder[i]]; }
+      free(group_list);
+      group_list = sorted;
+   }
+   remove_dups(header_name_list, group_list, emitorder, duplist, &entrynum);
+   selset_build(header_name_list, entrynum);
+   if(gbl_dupout){
+      int dups = write_selectors(gbl_dupout, header_name_list, emitorder, duplist, 1, entrynum);
+      if(dups){
+         (void) fprintf(stderr,"fastaselecth: %s: %d selectors are duplicated in -sel, listed in %s\n",
+            (gbl_cod ? "warning" : "fatal error"), dups, gbl_dupout);
+         if(!gbl_cod)exit(EXIT_FAILURE);
+      }
+   }
+
+   if(gbl_rename || gbl_prefix || gbl_stripdesc){
+      size_t maxnew=0;
+      if(gbl_rename){
+         rename_num = get_entries(gbl_rename, 1, bigstring, &rename_old, &rename_new, NULL);
+         int *rename_order = calloc(rename_num + 1,sizeof(int));
+         if(!rename_order)insane("fastaselecth: fatal error: could not allocate memory");
+         sort_entries(rename_old, rename_new, rename_order, rename_num);
+         free(rename_order);
+         for(i=0;i<rename_num;i++){
+            if(!rename_new[i]){
+               (void) fprintf(stderr,"fastaselecth: fatal error: -rename entry: %s\n",rename_old[i]);
+               insane("fastaselecth: fatal error: -rename entry lacks a new name");
+            }
+            if(i && !strcmp(rename_old[i-1],rename_old[i])){
+               (void) fprintf(stderr,"fastaselecth: fatal error: -rename entry: %s\n",rename_old[i]);
+               insane("fastaselecth: fatal error: -rename has more than one entry for a name");
+            }
+            if(strlen(rename_new[i]) > maxnew)maxnew = strlen(rename_new[i]);
+         }
+         if(!gbl_reject){  /* join once, so emitted records need no second lookup */
+            new_name_list = malloc(entrynum*sizeof(char *));
+            if(!new_name_list)insane("fastaselecth: fatal error: could not allocate memory");
+            for(i=0;i<entrynum;i++){
+               int r = bin_search(header_name_list[i], rename_old, rename_num);
+               new_name_list[i] = (r == -1 ? NULL : rename_new[r]);
+            }
+         }
+      }
+      outheader = malloc(gbl_wl + maxnew + (gbl_prefix ? strlen(gbl_prefix) : 0) + 2);
+      if(!outheader)insane("fastaselecth: fatal error: could not allocate memory");
+   }
 
    records=0;
    emit=0;
@@ -806,40 +4360,201 @@ int main(int argc, char *argv[]){
    accumstring=NULL;
    tail=size=0;
    lastemitted=-1;
-   FILE *fin = fopen(gbl_in,"r");
+   FILE *fin = open_in(gbl_in);
    if(!fin)insane("fastaselecth: fatal error: could not open -in");
+   tb = twobit_open(fin);
+   if(tb && (gbl_validate || gbl_statsall || gbl_replace || gbl_count || gbl_check || gbl_outfmt == OUTFMT_FAI)){
+      insane("fastaselecth: fatal error: a .2bit -in cannot be used with -validate, -stats-all, -replace-with, -count, -check or -out-format fai");
+   }
+   if(gbl_shmdir && !tb){
+      if(in_pid || gbl_reject || outheader || gbl_outfmt || gbl_statsout || gbl_validate || gbl_count || gbl_check){
+         (void) fprintf(stderr,"fastaselecth: warning: -shm-index is only used for plain selections from an uncompressed -in, scanning instead\n");
+      }
+      else {
+         ix = shmidx_open(gbl_shmdir, fin);
+      }
+   }
+   if(gbl_count || gbl_check){
+      count_selectors(fin, header_name_list, emitorder, entrynum);
+   }
+   if(gbl_frag == FRAG_GROUP){
+      /* -missing-out still lists in -sel order */
+      selorder = malloc((entrynum + 1)*sizeof(int));
+      if(!selorder)insane("fastaselecth: fatal error: could not allocate memory");
+      memcpy(selorder, emitorder, entrynum*sizeof(int));
+      group_order(group_list, emitorder, entrynum);
+   }
+   else {
+      selorder = emitorder;
+   }
+   catch_stop();
    FILE *fout=NULL;
    if(gbl_frag){
       fout = stdout;
-      last_group=empty_string;
+      if(gbl_outtar)tar_open(gbl_outtar);
    }
    else {
       if(!gbl_out || !strcmp(gbl_out,"-")){
          fout = stdout;
       }
       else {
+         out_track(gbl_out, 0);
          fout = fopen(gbl_out,"w");
          if(!fout)insane("fastaselecth: fatal error: could not open -out");
       }
    }
-   while( fgets(bigstring,MYMAXSTRING,fin) != NULL){
+   if(gbl_manifest){
+      out_track(gbl_manifest, 0);
+      mf_out = fopen(gbl_manifest,"w");
+      if(!mf_out)insane("fastaselecth: fatal error: could not open -manifest");
+      man_file(fout, (fout == stdout ? "-" : gbl_out));
+   }
+   if(gbl_validate)validate_init();
+   if(gbl_statsout){
+      sel_stats = calloc(1,sizeof(SEQSTATS));
+      if(!sel_stats)insane("fastaselecth: fatal error: could not allocate memory");
+      if(gbl_statsall){
+         all_stats = calloc(1,sizeof(SEQSTATS));
+         if(!all_stats)insane("fastaselecth: fatal error: could not allocate memory");
+      }
+   }
+   if(tb || ix){
+      /* .2bit or -shm-index: each record is read through the index when its turn comes, nothing is held */
+      long long j;
+      char *newname=NULL;
+      records = (tb ? tb->n : ix->n);
+      if(gbl_reject){
+         for(j=0;j<tb->n;j++){
+            if(stop_signal)break;
+            int matched = selset_find(tb->fnames[j], strlen(tb->fnames[j]), key_hash(tb->fnames[j], strlen(tb->fnames[j])));
+            if(matched != -1){
+               BIT_SET(emitlist,matched);
+               continue;
+            }
+            if(!page_take()){
+               if(page_full())break;
+               continue;
+            }
+            if(rename_num){
+               int r = bin_search(tb->fnames[j], rename_old, rename_num);
+               newname = (r == -1 ? NULL : rename_new[r]);
+            }
+            if(outheader){
+               rewrite_header(outheader, tb->fnames[j], strlen(tb->fnames[j]), newname);
+            }
+            else {
+               (void) sprintf(bigheader,">%s",tb->fnames[j]);
+            }
+            twobit_emit(tb, j, (outheader ? outheader : bigheader), fout, sel_stats);
+            emitted++;
+         }
+      }
+      else {
+         int *bypos = malloc(entrynum*sizeof(int));  /* selector for each -sel position */
+         if(!bypos)insane("fastaselecth: fatal error: could not allocate memory");
+         for(i=0;i<entrynum;i++){ bypos[emitorder[i]] = i; }
+         for(emitting=0;emitting<entrynum;emitting++){
+            if(stop_signal)break;
+            i = bypos[emitting];
+            j = (tb ? twobit_find(tb, header_name_list[i]) : shmidx_find(ix, header_name_list[i]));
+            if(j == -1)continue;
+            BIT_SET(emitlist,i);
+            if(!page_take()){
+               if(page_full()){
+                  DONE=1;  /* -head, the rest are not looked for */
+                  break;
+               }
+               continue;  /* -skip, never read */
+            }
+            if(gbl_frag){
+               if(group_list[i] == -1)insane("fastaselecth: fatal error: -frac[ac] used but one or more selectors lack second field");
+               if(last_group != group_list[i]){
+                  last_group = group_list[i];
+                  fout = frag_open(fout, last_group);
+               }
+            }
+            if(ix){
+               shmidx_emit(ix, j, fin, fout, bigstring);
+            }
+            else {
+               if(outheader){
+                  rewrite_header(outheader, tb->fnames[j], strlen(tb->fnames[j]), (new_name_list ? new_name_list[i] : NULL));
+               }
+               else {
+                  (void) sprintf(bigheader,">%s",tb->fnames[j]);
+               }
+               twobit_emit(tb, j, (outheader ? outheader : bigheader), fout, sel_stats);
+            }
+            emitted++;
+         }
+         free(bypos);
+         emitting=0;
+      }
+   }
+   else if(!gbl_outfmt && !gbl_statsout && !gbl_validate && !gbl_replace && !outheader){
+      SCANSTATE sc;
+      memset(&sc, 0, sizeof(sc));
+      sc.fin              = fin;
+      sc.fout             = fout;
+      sc.header_name_list = header_name_list;
+      sc.group_list       = group_list;
+      sc.entrynum         = entrynum;
+      sc.emitorder        = emitorder;
+      sc.emitstrings      = emitstrings;
+      sc.emitgroups       = emitgroups;
+      sc.emitlist         = emitlist;
+      sc.lastemitted      = lastemitted;
+      sc.last_group       = last_group;
+      sc.bigstring        = bigstring;
+      i = (gbl_reject ? scan_reject(&sc) : scan_select(&sc));
+      fout        = sc.fout;
+      lastemitted = sc.lastemitted;
+      last_group  = sc.last_group;
+      records     = sc.records;
+      emitted     = sc.emitted;
+      if(i)goto bye;
+   }
+   else while( fgets(bigstring,gbl_wl + 1,fin) != NULL){
       newline=strstr(bigstring,"\n");
       if(newline != NULL){  
          *newline='\0';  /* replace the \n with a terminator */
+         rawlen = newline - bigstring + 1;
          newline--;
       }
       else{ /* string truncated, record too long or EOF */
-         if(!feof(stdin)){
-            (void) fprintf(stderr,"fastaselecth: fatal error: input record in fasta file exceeds %d characters\n",MYMAXSTRING); 
+         if(!feof(fin)){
+            (void) fprintf(stderr,"fastaselecth: fatal error: input record in fasta file exceeds %d characters\n",gbl_wl); 
             exit(EXIT_FAILURE);
          }
         (void) fprintf(stderr,"fastaselecth warning: last line of file lacks a \\n \n"); 
-         newline=&(bigstring[strlen(bigstring) - 1]);
+         rawlen = strlen(bigstring);
+         newline=&(bigstring[rawlen - 1]);
       }
-      if(newline>=bigstring && *newline=='\r')*newline='\0';
+      had_cr = 0;
+      if(newline>=bigstring && *newline=='\r'){
+         *newline='\0';
+         newline--;
+         had_cr = 1;
+      }
+      linelen = newline + 1 - bigstring;
+      if(gbl_validate)validate_line(bigstring, linelen, had_cr, fileoffset);
+      outline = bigstring;
       
       if(bigstring[0] == '>'){
+         if(stop_signal)break;
          records++;
+
+         /* -out-format: the preceding emitted record is complete, replace it by its table line */
+         if(gbl_outfmt && emit){
+            accumstring = format_meta(meta_header, meta_hoffset, meta_soffset, meta_length, meta_linebases, meta_linewidth);
+            free(meta_header);
+            meta_header=NULL;
+            if(gbl_reject){
+               (void) fprintf(fout,"%s",accumstring);
+               free(accumstring);
+               accumstring=NULL;
+            }
+         }
       
          /* A new entry.  If the preceding entry was in the emitting state store the pointer to it in emitstrings */
          if(!gbl_reject && accumstring!=NULL){
@@ -849,48 +4564,11 @@ int main(int argc, char *argv[]){
             emitting=0;
             size=0;
             tail=0;
-            while(1){
-               if(emitstrings[lastemitted+1]!=NULL){  
-                  /* next one in order is available to emit.  The idea here is to emit the strings as soon as 
-                     possible rather than waiting until all have been collected and then doing them all at once.
-                     This is faster since it spreads the writes out over time, which can make a big difference if there
-                     are many megabytes of writes. */
-                  lastemitted++;
-                  if(gbl_frag && strcmp(last_group,emitgroups[lastemitted])){
-                     last_group = emitgroups[lastemitted];
-                     if(fout){
-                        fclose(fout);
-                     }
-                     sprintf(temp_name,gbl_out,last_group);
-                     if(gbl_frag == FRAG_APPEND){
-                         fout = fopen(temp_name,"a");
-                     }
-                     else if (gbl_frag == FRAG_NEW){
-                         FILE *fprobe = fopen(temp_name,"r");
-                         if(fprobe){
-                            fprintf(stderr,"fastaselecth: fatal error: file name: %s\n",temp_name);
-                            insane("fastaselecth: fatal error: -fragc mode output file already exists or noncontiguous group records");
-                         }
-                         else {
-                            fout = fopen(temp_name,"w");
-                         }
-                     }
-                     if(!fout){
-                        fprintf(stderr,"fastaselecth: fatal error: file name: %s\n",temp_name);
-                        insane("fastaselecth: fatal error: could not open output file in -frag mode");
-                     }
-                  }
-                  (void) fprintf(fout,"%s",emitstrings[lastemitted]);
-                  free(emitstrings[lastemitted]); /* release memory */
-               }
-               else {
-                  break;
-               }
-               // There may be more data in the input file but all the selected entries have been found
-               if(lastemitted == entrynum - 1){
-                  goto bye;
-               }
-            }
+            fout = drain(fout, emitstrings, emitgroups, &lastemitted, entrynum, &last_group, 0);
+            if(page_full())goto bye;  // -head, the rest is not wanted
+            // There may be more data in the input file but all the selected entries have been found
+            // -validate and -stats-all read to the end
+            if(lastemitted == entrynum - 1 && !gbl_validate && !gbl_statsall)goto bye;
          }
 
          /*does the name in bigstring match anything in the list?  Here "match" allows a space, tab, ^A or NULL to
@@ -908,18 +4586,33 @@ int main(int argc, char *argv[]){
             bigheader[b_num_chars]='\0';
          }
          emit = 0;
-         int matched = bin_search(bigheader, header_name_list, entrynum);
-         if((matched != -1) ^ gbl_reject){ // (matches and NOT reject) OR (NOT matches AND reject) == matches XOR reject
+         int matched = selset_match(bptr);
+         if(gbl_reject && matched != -1){
+            BIT_SET(emitlist,matched);  /* for -missing-out and -replace-with */
+            if(gbl_replace){
+               if(fwrite(update_text[emitorder[matched]], 1, update_len[emitorder[matched]], fout) != update_len[emitorder[matched]]){
+                  write_failed(fout, "fastaselecth: fatal error: could not write -out");
+               }
+               man_record(update_text[emitorder[matched]], update_len[emitorder[matched]]);
+               replaced++;
+            }
+         }
+         int take = (matched != -1) ^ gbl_reject; // (matches and NOT reject) OR (NOT matches AND reject) == matches XOR reject
+         if(take && gbl_reject && !page_take()){  /* -reject writes in input order, page here */
+            take = 0;
+            if(page_full())DONE=1;
+         }
+         if(take){
              if(!gbl_reject){
                 emitting=matched;
-                if(emitlist[matched]){
+                if(BIT_TEST(emitlist,matched)){
                    (void) fprintf(stderr,"fastaselecth: at fasta header: %s\n",bptr);
                    insane("fastaselecth: fatal error: duplicate entry name in FASTA file");
                 }
-                emitlist[matched]=1;
+                BIT_SET(emitlist,matched);
                 if(gbl_frag){
-                   if(!group_name_list[emitting] || !strlen(group_name_list[emitting]))insane("fastaselecth: fatal error: -frac[ac] used but one or more selectors lack second field");
-                   emitgroups[emitorder[emitting]]=group_name_list[emitting];
+                   if(group_list[emitting] == -1)insane("fastaselecth: fatal error: -frac[ac] used but one or more selectors lack second field");
+                   emitgroups[emitorder[emitting]]=group_list[emitting];
                 }
              }
              emit=1;
@@ -927,42 +4620,114 @@ int main(int argc, char *argv[]){
              tail=0;
              size=0;
              emitted++;
+             if(outheader){
+                char *newname = NULL;
+                if(new_name_list){
+                   newname = new_name_list[matched];
+                }
+                else if(rename_num){
+                   int r = bin_search(bigheader, rename_old, rename_num);
+                   if(r != -1)newname = rename_new[r];
+                }
+                rewrite_header(outheader, bptr, b_num_chars, newname);
+                outline = outheader;
+             }
+             if(gbl_outfmt){
+                meta_header    = lcl_strdup(outline + 1);
+                meta_hoffset   = fileoffset;
+                meta_soffset   = fileoffset + rawlen;
+                meta_length    = 0;
+                meta_linebases = 0;
+                meta_linewidth = 0;
+             }
          }
          if(b_num_chars){
             bigheader[b_num_chars] = save_char;
          }
+         if(sel_stats){
+            if(emit){
+               stats_header(sel_stats);
+            }
+            else {
+               stats_close(sel_stats);
+            }
+            if(all_stats)stats_header(all_stats);
+         }
+      }
+      else if(sel_stats){
+         if(emit)stats_line(sel_stats, bigstring, linelen);
+         if(all_stats)stats_line(all_stats, bigstring, linelen);
       }
 
-      if(emit){
+      if(emit && gbl_outfmt){
+        if(bigstring[0] != '>'){  // count, do not keep
+           if(!meta_length && !meta_linewidth){
+              meta_linebases = linelen;
+              meta_linewidth = rawlen;
+           }
+           meta_length += linelen;
+        }
+      }
+      else if(emit){
         if(gbl_reject){ //write immediately
-           (void) fprintf(fout,"%s\n",bigstring);
+           (void) fprintf(fout,"%s\n",outline);
+           if(outline[0] == '>')man_begin(outline);
+           man_add(outline, strlen(outline));
+           man_add("\n", 1);
         }
         else {
-           size=size + strlen(bigstring) + 2;
-           tbuf=malloc(size*sizeof(char));
-           if(tbuf==NULL)insane("fastaselecth: fatal error: ran out of memory during processing");
-           if(accumstring != NULL){
-             strcpy(tbuf,accumstring);
-             free(accumstring);
+           size_t olen = strlen(outline);
+           if(tail + olen + 2 > size){  /* grow by doubling, not by a copy per line */
+              size = 2*(tail + olen + 2);
+              tbuf=realloc(accumstring,size*sizeof(char));
+              if(tbuf==NULL)insane("fastaselecth: fatal error: ran out of memory during processing");
+              accumstring=tbuf;
            }
-           accumstring=tbuf;
-           (void) sprintf(&accumstring[tail],"%s\n",bigstring);
-           size--;
-           tail=size;
+           memcpy(&accumstring[tail],outline,olen);
+           tail += olen;
+           accumstring[tail++] = '\n';
+           accumstring[tail] = '\0';
         }
       }
+      fileoffset += rawlen;
       if(DONE)break;
    } /* end of reading loop */
+   if(stop_signal)stop_run(fout, entrynum, records, emitted);  /* also when the signal cut a read short */
+   if(gbl_validate)validate_line(NULL, 0, 0, fileoffset);
+
+   /* -out-format: the last record in -in may have been emitted */
+   if(gbl_outfmt && emit){
+      accumstring = format_meta(meta_header, meta_hoffset, meta_soffset, meta_length, meta_linebases, meta_linewidth);
+      free(meta_header);
+      meta_header=NULL;
+      if(gbl_reject){
+         (void) fprintf(fout,"%s",accumstring);
+         free(accumstring);
+         accumstring=NULL;
+      }
+   }
    
    /*if some were not found, now is the time to say so*/
    
-   if(!gbl_reject && (emitted <= entrynum - 1)){
+   if(gbl_missout){
+     missing = write_selectors(gbl_missout, header_name_list, selorder, emitlist, 0, entrynum);
+     if((!gbl_reject || gbl_replace) && missing){
+        (void)fprintf(stderr,"fastaselecth: %s: %d selectors were not found, listed in %s\n",
+           (gbl_com ? "warning" : "fatal error"), missing, gbl_missout);
+        if(!gbl_com){
+           exit(EXIT_FAILURE);
+        }
+     }
+   }
+   else if(gbl_replace || (!gbl_reject && (emitted <= entrynum - 1) && !DONE)){  /* -head may stop short of some */
+     missing = 0;
      for(i=0;i<entrynum;i++){
-        if(! emitlist[i]){
+        if(!BIT_TEST(emitlist,i)){
            (void)fprintf(stderr,"fastaselecth: %s: did not find selector: %s\n",(gbl_com ? "warning" : "fatal error"), header_name_list[i]);
+           missing++;
         }
      }
-     if(!gbl_com){
+     if(missing && !gbl_com){
         exit(EXIT_FAILURE);
      }
    }
@@ -976,61 +4741,89 @@ int main(int argc, char *argv[]){
 
    /* force out anything left in emitstrings.  If there was a miss it may have stalled
       very early...*/
-   for(lastemitted++; lastemitted < entrynum; lastemitted++){
-     if(emitstrings[lastemitted]!=NULL){  /* next one in order is available to emit */
-        if(gbl_frag && strcmp(last_group,emitgroups[lastemitted])){
-           last_group = emitgroups[lastemitted];
-           fclose(fout);
-           sprintf(temp_name,gbl_out,last_group);
-           if(gbl_frag == FRAG_APPEND){
-               fout = fopen(temp_name,"a");
-           }
-           else if (gbl_frag == FRAG_NEW){
-               FILE *fprobe = fopen(temp_name,"r");
-               if(fprobe){
-                  fprintf(stderr,"fastaselecth: fatal error: file name: %s\n",temp_name);
-                  insane("fastaselecth: fatal error: -fragc mode output file already exists or noncontiguous group records");
-               }
-               else {
-                  fout = fopen(temp_name,"w");
-               }
-           }
-           if(!fout){
-              fprintf(stderr,"fastaselecth: fatal error: file name: %s\n",temp_name);
-              insane("fastaselecth: fatal error: could not open output file in -frag mode");
-           }
-        }
-        (void) fprintf(fout,"%s",emitstrings[lastemitted]);
-        free(emitstrings[lastemitted]); /* release memory */
-     }
-   } 
+   fout = drain(fout, emitstrings, emitgroups, &lastemitted, entrynum, &last_group, 1);
+   lastemitted = entrynum;  /* not arriving by the goto, see -missing-out below */
 bye:
+   if(mf_out){
+      man_end();
+      if(fclose(mf_out))insane("fastaselecth: fatal error: could not write -manifest");
+      mf_out = NULL;
+   }
+   if(sel_stats){
+      FILE *fst;
+      if(strcmp(gbl_statsout,"-")){
+         fst = fopen(gbl_statsout,"w");
+         if(!fst)insane("fastaselecth: fatal error: could not open -stats-seq");
+      }
+      else {
+         fst = stdout;
+      }
+      stats_report(fst, "emitted", sel_stats);
+      free(sel_stats);
+      if(all_stats){
+         stats_report(fst, "all", all_stats);
+         free(all_stats);
+      }
+      if(fst!=stdout && fclose(fst))insane("fastaselecth: fatal error: could not write -stats-seq");
+   }
+   if(gbl_missout && lastemitted == entrynum - 1){
+      /* arrived by the goto, every selector was found */
+      (void) write_selectors(gbl_missout, header_name_list, selorder, emitlist, 0, entrynum);
+   }
 
    /* clean up */
-   fclose(fin);
-   if(fout!=stdout){
+   if(tb)twobit_free(tb);
+   if(ix)shmidx_free(ix);
+   close_in(fin);
+   if(tar_out){
+      tar_close();  /* fout was its spool file */
+   }
+   else if(fout!=stdout){
       fclose(fout);
    }
    free(bigheader);
    free(bigstring);
    free(emitlist);
+   free(duplist);
+   if(selorder != emitorder)free(selorder);
    free(emitorder);
    free(emitstrings);
    for(i=0;i<entrynum;i++){
       free(header_name_list[i]);
-      if(gbl_frag){
-         free(group_name_list[i]);
-      }
    }
-   free(emitgroups);  // all entries in emitgroups were pointers to a group_name_list entry
+   free(emitgroups);
+   free(group_list);
+   group_free();
+   selset_free();
    free(header_name_list);
-   if(gbl_frag){
-      free(group_name_list);
+   for(i=0;i<rename_num;i++){
+      free(rename_old[i]);
+      free(rename_new[i]);
    }
+   free(rename_old);
+   free(rename_new);
+   free(new_name_list);
+   free(outheader);
+   free(update_text);
+   free(update_len);
+   free(update_buf);
    free(gbl_hs);
    free(gbl_hi);
+   for(i=0;i<out_num;i++){
+      free(out_name[i]);
+   }
+   free(out_name);
+   free(out_size);
    
+   if(gbl_skip || gbl_head)emitted = page_out;
    fprintf(stderr,"fastaselecth: status: selectors: %d, records read: %llu, emitted: %llu\n",entrynum, records,emitted);
+   if(gbl_replace){
+      fprintf(stderr,"fastaselecth: status: replaced: %llu\n",replaced);
+   }
+
+   if(gbl_validate && validate_report()){
+      insane("fastaselecth: fatal error: -validate found problems in -in");
+   }
    
    exit(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -1,17 +1,57 @@
 import os
+import bisect
+import shlex
+import signal
+import shutil
+import tempfile
 import threading
 import subprocess
 import tkinter as tk
 from tkinter import filedialog, messagebox, ttk
 
-def run_pipeline(input_file, ids_file, output_dir, reject, single_fasta, progress_bar):
+# Running fastaselecth processes.  Each is started in a session of its own, so that Cancel
+# can signal it together with the rest of its pipeline.  fastaselecth stops at the next
+# record and removes its partial output files.
+running_processes = set()
+
+class RunCancelled(Exception):
+    pass
+
+def run_command(command, cwd):
+    process = subprocess.Popen(command, stderr=subprocess.PIPE, text=True, cwd=cwd, start_new_session=True)
+    process.cancelled = False
+    running_processes.add(process)
+    try:
+        stderr = process.communicate()[1]
+    finally:
+        running_processes.discard(process)
+    if process.cancelled:
+        raise RunCancelled()
+    if process.returncode:
+        raise subprocess.CalledProcessError(process.returncode, command, stderr=stderr)
+
+def cancel_runs():
+    for job in jobs:
+        if job["status"] == "queued":
+            set_job_status(job, "cancelled")
+    for process in list(running_processes):
+        process.cancelled = True
+        try:
+            os.killpg(process.pid, signal.SIGTERM)
+        except ProcessLookupError:
+            pass
+
+# Single-fasta files can go into one archive instead, one entry per ID, which spares shared
+# filesystems one file per ID.  It is compressed when zstd is there to do it.
+def archive_file(ids_file):
+    suffix = ".tar.zst" if shutil.which("zstd") else ".tar"
+    return f"{os.path.splitext(os.path.basename(ids_file))[0]}{suffix}"
+
+def run_pipeline(input_file, ids_file, output_dir, reject, single_fasta, archive, progress_bar):
 
     # Start the progress bar
     progress_bar.start()
 
-    # Change working directory
-    os.chdir(output_dir)
-    
     # Convert windows to wsl pathways for the ids file
     ids_file_fixed = str(ids_file).replace(" ","\ ")
 
@@ -26,27 +66,62 @@ def run_pipeline(input_file, ids_file, output_dir, reject, single_fasta, progres
             output_file = f"non_{os.path.splitext(os.path.basename(ids_file))[0]}.fasta"
 
         output_file_fixed = str(output_file).replace(" ","\ ")
+    elif archive:
+        output_file = archive_file(ids_file)
+        output_file_fixed = str(output_file).replace(" ","\ ")
+
+    # Missing IDs are written here by fastaselecth
+    missing_fd, missing_file = tempfile.mkstemp(prefix="fastaselecth_missing_", suffix=".txt")
+    os.close(missing_fd)
+    missing_file_fixed = str(missing_file).replace(" ","\ ")
     
     # Run command
     if not single_fasta:
         if not reject:
-            command = f"fastaselecth -com -in {fasta_file_fixed} -sel {ids_file_fixed} -out {output_file_fixed}"
+            command = f"fastaselecth -com -missing-out {missing_file_fixed} -in {fasta_file_fixed} -sel {ids_file_fixed} -out {output_file_fixed}"
         else:
-            command = f"fastaselecth -com -reject -in {fasta_file_fixed} -sel {ids_file_fixed} -out {output_file_fixed}"
+            command = f"fastaselecth -com -reject -missing-out {missing_file_fixed} -in {fasta_file_fixed} -sel {ids_file_fixed} -out {output_file_fixed}"
     else:
-            command = f"paste {ids_file_fixed} {ids_file_fixed} | fastaselecth -com -fragc -in {fasta_file_fixed} -sel \"-\" -out \"%s.fasta\""
+            command = f"paste {ids_file_fixed} {ids_file_fixed} | fastaselecth -com -fragc -missing-out {missing_file_fixed} -in {fasta_file_fixed} -sel \"-\" -out \"%s.fasta\""
+            if archive:
+                command += f" -out-tar {output_file_fixed}"
 
     try:
-        subprocess.run(["bash", "-c", command], check=True)
+        # Run in the output directory, jobs from the queue may be running at the same time
+        run_command(["bash", "-c", command], output_dir)
         progress_bar.stop()
+        with open(missing_file) as f:
+            missing_ids = [line.rstrip("\n") for line in f if line.strip()]
         if not single_fasta:
-            messagebox.showinfo("Success", f"Output file created at {os.path.abspath(output_file)}")
+            message = f"Output file created at {os.path.join(output_dir, output_file)}"
+        elif archive:
+            message = f"Output archive created at {os.path.join(output_dir, output_file)}"
         else:
-            messagebox.showinfo("Success", f"Output files created at {output_dir}")
+            message = f"Output files created at {output_dir}"
+        if not missing_ids:
+            messagebox.showinfo("Success", message)
+            os.remove(missing_file)
+        else:
+            # Dialogs which ask for a file name must run in the tkinter thread
+            app.after(0, report_missing, message, missing_ids, missing_file)
+
+    except RunCancelled:
+        progress_bar.stop()
+        os.remove(missing_file)
+        messagebox.showinfo("Cancelled", "The run was cancelled and its partial output files were removed.")
 
     except subprocess.CalledProcessError as e:
         progress_bar.stop()
-        messagebox.showerror(f"Error: {e}")
+        os.remove(missing_file)
+        messagebox.showerror("Error", f"Error: {e}\n\n{e.stderr}")
+
+def report_missing(message, missing_ids, missing_file):
+    save = messagebox.askyesno("Success", f"{message}\n\n{len(missing_ids)} IDs were not found in the FASTA file.\nSave the list of missing IDs?")
+    if save:
+        file_path = filedialog.asksaveasfilename(defaultextension=".txt", initialfile="missing_ids.txt")
+        if file_path:
+            shutil.copyfile(missing_file, file_path)
+    os.remove(missing_file)
         
 def start_thread():
     input_file = input_file_var.get()
@@ -54,6 +129,7 @@ def start_thread():
     output_dir = output_dir_var.get()
     reject = reject_var.get()
     single_fasta = single_fasta_var.get()
+    archive = archive_var.get()
     
     if not input_file:
         messagebox.showwarning("Input Error", "Please select an input FASTA file.")
@@ -70,10 +146,378 @@ def start_thread():
         messagebox.showwarning("Input Error", "The reject option cannot be used with single-fasta files as output.")
         return        
 
-    # Start command in a new thread
-    thread = threading.Thread(target=run_pipeline, args=(input_file, ids_file, output_dir, reject, single_fasta, progress_bar))
+    # Start command in a new thread, and the preview of its first records next to it
+    start_preview()
+    thread = threading.Thread(target=run_pipeline, args=(input_file, ids_file, output_dir, reject, single_fasta, archive, progress_bar))
     thread.start()
 
+# Preview of the first records a run writes, from a quick fastaselecth -head run next to the
+# full one, so that wrong IDs or delimiters show up at once instead of after the whole run.
+PREVIEW_RECORDS = 10
+
+def run_preview(input_file, ids_file, reject):
+    command = ["fastaselecth", "-com", "-head", str(PREVIEW_RECORDS), "-out-format", "tsv",
+               "-in", input_file, "-sel", ids_file]
+    if reject:
+        command.insert(1, "-reject")
+    try:
+        result = subprocess.run(command, check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+        rows = [line.split("\t", 3) for line in result.stdout.splitlines()]
+        app.after(0, show_preview, rows, "")
+    except (subprocess.CalledProcessError, OSError) as e:
+        app.after(0, show_preview, [], getattr(e, "stderr", None) or str(e))
+
+def show_preview(rows, error):
+    preview_tree.delete(*preview_tree.get_children())
+    for name, length, offset, description in rows:
+        preview_tree.insert("", "end", values=(name, length, description))
+    if error:
+        preview_status_var.set(f"Preview failed: {error.strip()}")
+    elif not rows:
+        preview_status_var.set("No records match, check the IDs and the FASTA headers")
+    else:
+        preview_status_var.set(f"First {len(rows)} records written")
+
+def start_preview():
+    input_file = input_file_var.get()
+    ids_file = ids_file_var.get()
+    if not input_file or not ids_file:
+        messagebox.showwarning("Input Error", "Please select an input FASTA file and an input TXT file.")
+        return
+    preview_status_var.set("Previewing...")
+    threading.Thread(target=run_preview, args=(input_file, ids_file, reject_var.get()), daemon=True).start()
+
+# Job queue.  Each job is a dict with the run_pipeline arguments, its list of IDs, its
+# status and its row in the queue panel.  At most max_jobs_var jobs run at once.  Plain
+# selections from the same FASTA are run as one fastaselecth scan, each job's IDs going
+# to its own output file through -fragc groups.  The limit counts jobs, not cores: a job
+# reading compressed FASTA also runs a decompressor, the default of half the cores leaves
+# room for it.
+jobs = []
+running_jobs = 0
+
+def job_output_file(job):
+    name = os.path.splitext(os.path.basename(job["ids_file"]))[0]
+    if job["reject"]:
+        name = f"non_{name}"
+    return os.path.join(job["output_dir"], f"{name}.fasta")
+
+# Select and reject jobs write to this name and it is renamed to job_output_file() when the
+# run succeeds, so that a failed or cancelled run leaves an earlier result as it was.
+def partial_output_file(job):
+    return f"{job_output_file(job)}.partial"
+
+def read_ids(ids_file):
+    # The ID is the text before the first of fastaselecth's default delimiters "|\t :"
+    ids = []
+    with open(ids_file) as f:
+        for line in f:
+            for delimiter in "|\t :":
+                line = line.split(delimiter)[0]
+            line = line.strip("\r\n")
+            if line:
+                ids.append(line)
+    return ids
+
+def set_job_status(job, status):
+    job["status"] = status
+    queue_tree.set(job["row"], "status", status)
+
+def add_job():
+    input_file = input_file_var.get()
+    ids_file = ids_file_var.get()
+    output_dir = output_dir_var.get()
+    reject = reject_var.get()
+    single_fasta = single_fasta_var.get()
+
+    if not input_file or not ids_file or not output_dir:
+        messagebox.showwarning("Input Error", "Please select the input FASTA file, the input TXT file and the output directory.")
+        return
+    if single_fasta and reject:
+        messagebox.showwarning("Input Error", "The reject option cannot be used with single-fasta files as output.")
+        return
+    try:
+        ids = read_ids(ids_file)
+    except OSError as e:
+        messagebox.showerror("Error", f"Error: {e}")
+        return
+
+    archive = single_fasta and archive_var.get()
+    mode = "reject" if reject else ("single-fasta" + (" (tar)" if archive else "") if single_fasta else "select")
+    job = {"input_file": input_file, "ids_file": ids_file, "output_dir": output_dir, "reject": reject,
+           "single_fasta": single_fasta, "archive": archive, "ids": ids, "status": "queued", "error": ""}
+    job["row"] = queue_tree.insert("", "end", values=(os.path.basename(input_file), os.path.basename(ids_file), mode, "queued"))
+    jobs.append(job)
+
+def mergeable(job):
+    return not job["reject"] and not job["single_fasta"]
+
+def max_jobs():
+    # The Spinbox can be left empty or hold text
+    try:
+        return max(1, max_jobs_var.get())
+    except tk.TclError:
+        return 1
+
+def schedule_jobs():
+    global running_jobs
+    while running_jobs < max_jobs():
+        queued = [job for job in jobs if job["status"] == "queued"]
+        if not queued:
+            break
+        batch = [queued[0]]
+        if mergeable(queued[0]):
+            # -fragc keeps only the first of repeated IDs, so only jobs with no IDs in common are merged
+            seen = set(queued[0]["ids"])
+            for job in queued[1:]:
+                if mergeable(job) and job["input_file"] == queued[0]["input_file"] and seen.isdisjoint(job["ids"]):
+                    batch.append(job)
+                    seen.update(job["ids"])
+        for job in batch:
+            set_job_status(job, "running" if len(batch) == 1 else f"running ({len(batch)} merged)")
+        running_jobs += 1
+        threading.Thread(target=run_batch, args=(batch,)).start()
+
+def run_batch(batch):
+    first = batch[0]
+    missing_fd, missing_file = tempfile.mkstemp(prefix="fastaselecth_missing_", suffix=".txt")
+    os.close(missing_fd)
+    sel_file = None
+    try:
+        if len(batch) == 1 and first["single_fasta"]:
+            command = ["bash", "-c", f"paste {shlex.quote(first['ids_file'])} {shlex.quote(first['ids_file'])} | "
+                       f"fastaselecth -com -fragc -missing-out {shlex.quote(missing_file)} -in {shlex.quote(first['input_file'])} -sel - -out %s.fasta"
+                       + (f" -out-tar {shlex.quote(archive_file(first['ids_file']))}" if first["archive"] else "")]
+        elif len(batch) == 1:
+            command = ["fastaselecth", "-com", "-missing-out", missing_file, "-in", first["input_file"],
+                       "-sel", first["ids_file"], "-out", partial_output_file(first)]
+            if first["reject"]:
+                command.insert(1, "-reject")
+        else:
+            sel_fd, sel_file = tempfile.mkstemp(prefix="fastaselecth_queue_", suffix=".txt")
+            with os.fdopen(sel_fd, "w") as f:
+                for job in batch:
+                    output_file = partial_output_file(job)
+                    if os.path.exists(output_file):
+                        os.remove(output_file)  # left by an earlier run, -fragc will not overwrite
+                    for id in job["ids"]:
+                        f.write(f"{id}\t{output_file}\n")
+            command = ["fastaselecth", "-com", "-fragc", "-hs", "\\t", "-missing-out", missing_file,
+                       "-in", first["input_file"], "-sel", sel_file, "-out", "%s"]
+        run_command(command, first["output_dir"])
+        if not first["single_fasta"]:
+            for job in batch:
+                if os.path.exists(partial_output_file(job)):
+                    os.replace(partial_output_file(job), job_output_file(job))
+                else:
+                    open(job_output_file(job), "w").close()  # -fragc writes no file for a job with all IDs missing
+        with open(missing_file) as f:
+            missing_ids = set(line.rstrip("\n") for line in f if line.strip())
+        results = []
+        for job in batch:
+            missing = len(missing_ids.intersection(job["ids"]))
+            results.append((job, f"done, {missing} IDs not found" if missing else "done", ""))
+    except RunCancelled:
+        results = [(job, "cancelled", "") for job in batch]
+    except (subprocess.CalledProcessError, OSError) as e:
+        results = [(job, "failed", f"{e}\n\n{getattr(e, 'stderr', '')}") for job in batch]
+    finally:
+        os.remove(missing_file)
+        if sel_file:
+            os.remove(sel_file)
+        for job in batch:
+            if not job["single_fasta"] and os.path.exists(partial_output_file(job)):
+                os.remove(partial_output_file(job))
+    app.after(0, batch_done, results)
+
+def batch_done(results):
+    global running_jobs
+    running_jobs -= 1
+    for job, status, error in results:
+        job["error"] = error
+        set_job_status(job, status)
+    schedule_jobs()
+
+def remove_finished_jobs():
+    for job in [job for job in jobs if job["status"] not in ("queued",) and not job["status"].startswith("running")]:
+        queue_tree.delete(job["row"])
+        jobs.remove(job)
+
+def show_job_error(event):
+    for row in queue_tree.selection():
+        for job in jobs:
+            if job["row"] == row and job["error"]:
+                messagebox.showerror("Error", f"Error: {job['error']}")
+
+# ID index of the chosen FASTA, (name, length, description) sorted by name.  It is made in
+# the background by fastaselecth, listing every record, and cached under a name taken from
+# the sampled fingerprint of the file, so it is only rebuilt when the file changes.
+SEARCH_LIMIT = 200
+SEARCH_DELAY = 250  # ms without a keystroke before the search runs
+index_file = None
+index_records = []
+index_names = []
+index_text = []
+selected_ids = []
+search_window = None
+search_after = None
+search_generation = 0
+
+def index_cache_file(input_file):
+    result = subprocess.run(["fastaselecth", "-in", input_file, "-fingerprint", "sampled"],
+                            check=True, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
+    key = result.stdout.split("\t")[1]
+    cache_dir = os.path.join(os.path.expanduser("~"), ".cache", "fastaselecth")
+    os.makedirs(cache_dir, exist_ok=True)
+    return os.path.join(cache_dir, f"{key}.tsv")
+
+def load_index(input_file):
+    try:
+        cache_file = index_cache_file(input_file)
+        if not os.path.exists(cache_file):
+            partial_file = f"{cache_file}.{os.getpid()}"
+            subprocess.run(["fastaselecth", "-reject", "-sel", os.devnull, "-out-format", "tsv",
+                            "-in", input_file, "-out", partial_file], check=True, stderr=subprocess.PIPE, text=True)
+            os.replace(partial_file, cache_file)
+        records = []
+        with open(cache_file) as f:
+            for line in f:
+                name, length, offset, description = line.rstrip("\n").split("\t", 3)
+                records.append((name, int(length), description))
+        records.sort()
+        app.after(0, index_ready, input_file, records, "")
+    except (subprocess.CalledProcessError, OSError, ValueError) as e:
+        app.after(0, index_ready, input_file, [], getattr(e, "stderr", None) or str(e))
+
+def index_ready(input_file, records, error):
+    global index_file, index_records, index_names, index_text
+    if input_file != input_file_var.get():
+        return  # another FASTA was chosen meanwhile
+    index_file = input_file
+    index_records = records
+    index_names = [record[0] for record in records]
+    index_text = [f"{record[0]}\t{record[2]}".lower() for record in records]
+    if error:
+        index_status_var.set("Index failed")
+        messagebox.showerror("Error", f"Could not index {input_file}:\n\n{error}")
+    else:
+        index_status_var.set(f"{len(records)} IDs")
+    update_search_results()
+
+def fasta_changed(*args):
+    input_file = input_file_var.get()
+    if input_file == index_file or not os.path.isfile(input_file):
+        return
+    index_status_var.set("Indexing...")
+    threading.Thread(target=load_index, args=(input_file,), daemon=True).start()
+
+# IDs starting with the query are shown first, found by bisection in the Tk thread, then IDs
+# or descriptions containing it, from a pass over the whole index in a worker thread.  Each
+# search has a generation number, a worker whose search was replaced stops and its results
+# are dropped.  Typing only runs the search once it pauses for SEARCH_DELAY.
+def schedule_search(*args):
+    global search_after
+    if search_after:
+        app.after_cancel(search_after)
+    search_after = app.after(SEARCH_DELAY, update_search_results)
+
+def substring_search(query, text, records, prefix, room, generation):
+    found = []
+    for i, line in enumerate(text):
+        if not i % 65536 and generation != search_generation:
+            return
+        if query in line and i not in prefix:
+            found.append(records[i])
+            if len(found) >= room:
+                break
+    app.after(0, show_search_results, found, generation)
+
+def show_search_results(records, generation):
+    if not search_window or generation != search_generation:
+        return
+    for name, length, description in records:
+        results_tree.insert("", "end", values=(name, length, description))
+
+def update_search_results(*args):
+    global search_after, search_generation
+    search_after = None
+    search_generation += 1
+    if not search_window:
+        return
+    results_tree.delete(*results_tree.get_children())
+    query = search_var.get().strip()
+    if not query:
+        return
+    found = []
+    i = bisect.bisect_left(index_names, query)
+    while i < len(index_names) and index_names[i].startswith(query) and len(found) < SEARCH_LIMIT:
+        found.append(i)
+        i += 1
+    show_search_results([index_records[i] for i in found], search_generation)
+    if len(query) >= 2 and len(found) < SEARCH_LIMIT:
+        threading.Thread(target=substring_search, args=(query.lower(), index_text, index_records, set(found),
+                         SEARCH_LIMIT - len(found), search_generation), daemon=True).start()
+
+def add_selected_ids():
+    for row in results_tree.selection():
+        name = str(results_tree.item(row, "values")[0])
+        if name not in selected_ids:
+            selected_ids.append(name)
+            selected_listbox.insert("end", name)
+
+def remove_selected_ids():
+    for position in reversed(selected_listbox.curselection()):
+        selected_listbox.delete(position)
+        del selected_ids[position]
+
+def save_selected_ids():
+    if not selected_ids:
+        return
+    file_path = filedialog.asksaveasfilename(defaultextension=".txt", initialfile="ids.txt")
+    if file_path:
+        with open(file_path, "w") as f:
+            f.write("".join(f"{name}\n" for name in selected_ids))
+        ids_file_var.set(file_path)
+
+def close_search():
+    global search_window, search_after
+    if search_after:
+        app.after_cancel(search_after)
+        search_after = None
+    search_window.destroy()
+    search_window = None
+
+def open_search():
+    global search_window, search_var, results_tree, selected_listbox
+    if search_window:
+        search_window.lift()
+        return
+    search_window = tk.Toplevel(app)
+    search_window.title("Search IDs")
+    search_window.protocol("WM_DELETE_WINDOW", close_search)
+
+    search_var = tk.StringVar()
+    search_var.trace_add("write", schedule_search)
+    tk.Label(search_window, text="ID or description:").grid(row=0, column=0, padx=10, pady=10, sticky="e")
+    tk.Entry(search_window, textvariable=search_var, width=40).grid(row=0, column=1, padx=10, pady=10, sticky="w")
+    tk.Label(search_window, textvariable=index_status_var).grid(row=0, column=2, padx=10, pady=10)
+
+    results_tree = ttk.Treeview(search_window, columns=("id", "length", "description"), show="headings", height=12)
+    for column, heading, width in (("id", "ID", 180), ("length", "Length", 80), ("description", "Description", 300)):
+        results_tree.heading(column, text=heading)
+        results_tree.column(column, width=width)
+    results_tree.grid(row=1, column=0, columnspan=3, padx=10, pady=10)
+    results_tree.bind("<Double-1>", lambda event: add_selected_ids())
+
+    tk.Button(search_window, text="Add to list", command=add_selected_ids).grid(row=2, column=0, padx=10, pady=10)
+    selected_listbox = tk.Listbox(search_window, selectmode="extended", height=8, width=40)
+    selected_listbox.grid(row=3, column=0, columnspan=2, padx=10, pady=10)
+    for name in selected_ids:
+        selected_listbox.insert("end", name)
+    tk.Button(search_window, text="Remove", command=remove_selected_ids).grid(row=3, column=2, padx=10, pady=10)
+    tk.Button(search_window, text="Save list and use it", command=save_selected_ids).grid(row=4, column=1, padx=10, pady=10)
+    update_search_results()
+
 def select_fasta_file():
     file_path = filedialog.askopenfilename()
     input_file_var.set(file_path)
@@ -94,12 +538,16 @@ input_file_var = tk.StringVar()
 tk.Label(app, text="Input FASTA File:").grid(row=0, column=0, padx=10, pady=10, sticky="e")
 tk.Entry(app, textvariable=input_file_var, width=40).grid(row=0, column=1, padx=10, pady=10)
 tk.Button(app, text="Browse", command=select_fasta_file).grid(row=0, column=2, padx=10, pady=10)
+index_status_var = tk.StringVar()
+tk.Label(app, textvariable=index_status_var).grid(row=0, column=3, padx=10, pady=10)
+input_file_var.trace_add("write", fasta_changed)
 
 # Input file selection
 ids_file_var = tk.StringVar()
 tk.Label(app, text="Input 1-column TXT File With IDs:").grid(row=1, column=0, padx=10, pady=10, sticky="e")
 tk.Entry(app, textvariable=ids_file_var, width=40).grid(row=1, column=1, padx=10, pady=10)
 tk.Button(app, text="Browse", command=select_ids_file).grid(row=1, column=2, padx=10, pady=10)
+tk.Button(app, text="Search IDs", command=open_search).grid(row=1, column=3, padx=10, pady=10)
 
 # Input file selection
 output_dir_var = tk.StringVar()
@@ -114,6 +562,8 @@ tk.Checkbutton(app, text=" Reject selected entries", variable=reject_var).grid(r
 # Checkbox for additional option
 single_fasta_var = tk.BooleanVar(value=False)
 tk.Checkbutton(app, text="Export to single-fasta files", variable=single_fasta_var).grid(row=4, column=1, padx=10, pady=10, sticky="w")
+archive_var = tk.BooleanVar(value=False)
+tk.Checkbutton(app, text="In one archive", variable=archive_var).grid(row=4, column=2, padx=10, pady=10, sticky="w")
 
 # Progress Bar (indeterminate)
 progress_bar = ttk.Progressbar(app, mode="indeterminate", length=200)
@@ -121,5 +571,32 @@ progress_bar.grid(row=5, column=0, columnspan=3, padx=10, pady=20)
 
 # Start button
 tk.Button(app, text="Run program", command=start_thread).grid(row=6, column=1, padx=10, pady=20)
+tk.Button(app, text="Preview", command=start_preview).grid(row=6, column=2, padx=10, pady=20)
+tk.Button(app, text="Cancel", command=cancel_runs).grid(row=6, column=0, padx=10, pady=20, sticky="e")
+
+# Job queue panel
+tk.Button(app, text="Add to queue", command=add_job).grid(row=7, column=0, padx=10, pady=10, sticky="e")
+max_jobs_var = tk.IntVar(value=max(1, (os.cpu_count() or 2) // 2))
+tk.Label(app, text="Job limit:").grid(row=7, column=1, padx=10, pady=10, sticky="e")
+tk.Spinbox(app, from_=1, to=os.cpu_count() or 1, textvariable=max_jobs_var, width=5).grid(row=7, column=2, padx=10, pady=10, sticky="w")
+
+queue_tree = ttk.Treeview(app, columns=("fasta", "ids", "mode", "status"), show="headings", height=6)
+for column, heading, width in (("fasta", "FASTA", 160), ("ids", "IDs", 160), ("mode", "Mode", 90), ("status", "Status", 200)):
+    queue_tree.heading(column, text=heading)
+    queue_tree.column(column, width=width)
+queue_tree.grid(row=8, column=0, columnspan=3, padx=10, pady=10)
+queue_tree.bind("<Double-1>", show_job_error)
+
+tk.Button(app, text="Run queue", command=schedule_jobs).grid(row=9, column=0, padx=10, pady=10, sticky="e")
+tk.Button(app, text="Remove finished", command=remove_finished_jobs).grid(row=9, column=1, padx=10, pady=10)
+
+# Preview pane
+preview_status_var = tk.StringVar()
+tk.Label(app, textvariable=preview_status_var).grid(row=10, column=0, columnspan=3, padx=10, pady=5)
+preview_tree = ttk.Treeview(app, columns=("id", "length", "description"), show="headings", height=PREVIEW_RECORDS)
+for column, heading, width in (("id", "ID", 180), ("length", "Length", 80), ("description", "Description", 350)):
+    preview_tree.heading(column, text=heading)
+    preview_tree.column(column, width=width)
+preview_tree.grid(row=11, column=0, columnspan=3, padx=10, pady=10)
 
 app.mainloop()